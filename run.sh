@@ -1,2 +1,2 @@
 mkdir build
-make && echo "---------------------" && ./build/main "$1"
\ No newline at end of file
+make && echo "---------------------" && ./build/main "$@"
\ No newline at end of file
@@ -1,8 +1,30 @@
 mkdir build
 make \
-&& bash run.sh tests/string_construct.txt \
+&& bash run.sh tests/string_contruct.txt \
 && bash run.sh tests/squares.txt \
 && bash run.sh tests/sort_array.txt \
 && bash run.sh tests/sincos.txt \
 && bash run.sh tests/dict.txt \
-&& bash run.sh tests/speed.txt
\ No newline at end of file
+&& bash run.sh tests/scopes.txt \
+&& bash run.sh tests/array.txt \
+&& bash run.sh tests/string_search.txt \
+&& bash run.sh tests/literals.txt \
+&& bash run.sh --gc-min-heap=1000 tests/gc.txt \
+&& bash run.sh --stats --gc-min-heap=1000 tests/top_level.txt 2>&1 | awk '{ print } /objects on the heap/ { heap = $(NF - 4) } END { exit heap >= 1000 }' \
+&& bash run.sh --stream --stats --gc-min-heap=1000 tests/top_level.txt 2>&1 | awk '{ print } /^pool: [0-9]/ && $4 + 0 >= 1000 { big = 1 } /objects on the heap/ { heap = $(NF - 4) } END { exit big || heap >= 1000 }' \
+&& bash run.sh tests/speed.txt \
+&& bash run.sh --vm tests/string_contruct.txt \
+&& bash run.sh --vm tests/squares.txt \
+&& bash run.sh --vm tests/sort_array.txt \
+&& bash run.sh --vm tests/sincos.txt \
+&& bash run.sh --vm tests/dict.txt \
+&& bash run.sh --vm tests/scopes.txt \
+&& bash run.sh --vm tests/array.txt \
+&& bash run.sh --vm tests/string_search.txt \
+&& bash run.sh --vm tests/literals.txt \
+&& bash run.sh --vm --gc-min-heap=1000 tests/gc.txt \
+&& bash run.sh --vm --stats --gc-min-heap=1000 tests/top_level.txt 2>&1 | awk '{ print } /objects on the heap/ { heap = $(NF - 4) } END { exit heap >= 1000 }' \
+&& bash run.sh --vm --stream --stats --gc-min-heap=1000 tests/top_level.txt 2>&1 | awk '{ print } /^pool: [0-9]/ && $4 + 0 >= 1000 { big = 1 } /objects on the heap/ { heap = $(NF - 4) } END { exit big || heap >= 1000 }' \
+&& bash run.sh --vm tests/speed.txt \
+&& for f in tests/errors/*.txt; do diff <(./build/main "$f" 2>&1) <(./build/main --vm "$f" 2>&1) || exit 1; done \
+&& echo "errors done"
@@ -0,0 +1,284 @@
+#include "cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include <unistd.h>
+
+#include "parser.hpp"
+#include "names.hpp"
+#include "hashing.hpp"
+
+namespace Cache {
+    // must change whenever the stored node fields or the layout below change,
+    // the number of node ids and of keywords and the build of the interpreter are checked on their own
+    static const uint32_t format_version = 3;
+    static const char magic[8] = {'B', 'R', 'U', 'A', 'A', 'S', 'T', '\0'};
+    static const uint64_t seed = 0x6361636865;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+        uint32_t num_node_ids, num_keywords; // a grammar change renumbers the ids stored in records
+        uint64_t build_id;
+        uint64_t source_size, source_hash;
+        uint64_t num_names, num_forms, num_records, text_size;
+    };
+    struct NameEntry {
+        uint64_t offset, size; // in the text
+    };
+    struct Record {
+        uint64_t value; // bits of the literal, index of the name or offset of the string in the text
+        int32_t begin_in_text, end_in_text;
+        uint32_t id, kids;
+        uint64_t size; // of the string
+    };
+    // the files are read in place, so their layout must not depend on the compiler
+    static_assert(sizeof(Header) == 80 && offsetof(Header, source_size) == 32, "cache header layout changed");
+    static_assert(sizeof(NameEntry) == 16, "cache name layout changed");
+    static_assert(sizeof(Record) == 32 && offsetof(Record, id) == 16 && offsetof(Record, size) == 24,
+                  "cache record layout changed");
+
+    static const uint32_t num_node_ids = Parser::BLOCK + 1;
+    static const uint32_t num_keywords = Tokenizer::OPEN_BRACKET;
+
+    static std::string CachePath(const std::string &file) {
+        return file + ".cache";
+    }
+
+    static uint64_t SourceHash(const Tokenizer::Source &source) {
+        return Hashing::HashBytes(seed, source.data, source.size);
+    }
+
+    // hash of the executable of the interpreter, so that a cache is only read by the build which wrote it,
+    // whatever changed in between. 0 if the executable can't be read, then caches are not used at all
+    static uint64_t BuildId() {
+        static uint64_t res = 0;
+        static bool known = false;
+        if (known) return res;
+        known = true;
+
+        Tokenizer::Source exe;
+        if (!Tokenizer::Load("/proc/self/exe", exe)) return res;
+        res = Hashing::HashBytes(seed, exe.data, exe.size);
+        if (res == 0) res = 1;
+        Tokenizer::Unload(exe);
+        return res;
+    }
+
+    struct Writer {
+        std::vector<NameEntry> names;
+        std::unordered_map<uint64_t, uint64_t> name_index; // by name id
+        std::vector<Record> records;
+        std::string text;
+    };
+
+    static void Write(Writer &writer, Node *node) {
+        Record record{};
+        record.id = Parser::GetId(node);
+        record.begin_in_text = Parser::GetBeginInText(node);
+        record.end_in_text = Parser::GetEndInText(node);
+        record.kids = Parser::GetKids(node).size();
+
+        switch (Parser::GetId(node)) {
+            case Parser::NAME: {
+                Names::Name name = Parser::GetName(node);
+                auto it = writer.name_index.find(name.id);
+                if (it == writer.name_index.end()) {
+                    it = writer.name_index.emplace(name.id, writer.names.size()).first;
+                    writer.names.push_back(NameEntry{writer.text.size(), name.str.size()});
+                    writer.text += name.str;
+                }
+                record.value = it->second;
+                break;
+            }
+            case Parser::BOOL_LITERAL: {
+                record.value = Parser::GetBool(node);
+                break;
+            }
+            case Parser::CHAR_LITERAL: {
+                record.value = (uint8_t)Parser::GetChar(node);
+                break;
+            }
+            case Parser::INT_LITERAL: {
+                memcpy(&record.value, &Parser::GetInt(node), sizeof(record.value));
+                break;
+            }
+            case Parser::REAL_LITERAL: {
+                memcpy(&record.value, &Parser::GetReal(node), sizeof(record.value));
+                break;
+            }
+            case Parser::STRING_LITERAL: {
+                record.value = writer.text.size();
+                record.size = Parser::GetString(node).size();
+                writer.text += Parser::GetString(node);
+                break;
+            }
+            default: break;
+        }
+        writer.records.push_back(record);
+
+        for (Node *kid: Parser::GetKids(node)) Write(writer, kid);
+    }
+
+    static bool WriteAll(FILE *fd, const void *data, size_t size) {
+        return size == 0 || fwrite(data, 1, size, fd) == size;
+    }
+
+    void Store(const std::string &file, const Tokenizer::Source &source, const std::vector<Node*> &forms) {
+        if (!source.mapped || BuildId() == 0) return;
+
+        Writer writer;
+        for (Node *form: forms) Write(writer, form);
+
+        Header header{};
+        memcpy(header.magic, magic, sizeof(magic));
+        header.version = format_version;
+        header.record_size = sizeof(Record);
+        header.num_node_ids = num_node_ids;
+        header.num_keywords = num_keywords;
+        header.build_id = BuildId();
+        header.source_size = source.size;
+        header.source_hash = SourceHash(source);
+        header.num_names = writer.names.size();
+        header.num_forms = forms.size();
+        header.num_records = writer.records.size();
+        header.text_size = writer.text.size();
+
+        // written aside and renamed, so other runs never see a half-written cache
+        std::string path = CachePath(file), temp = path + "." + std::to_string(getpid());
+        FILE *fd = fopen(temp.c_str(), "wb");
+        if (fd == NULL) return;
+        bool ok = WriteAll(fd, &header, sizeof(header))
+               && WriteAll(fd, writer.names.data(), writer.names.size() * sizeof(NameEntry))
+               && WriteAll(fd, writer.records.data(), writer.records.size() * sizeof(Record))
+               && WriteAll(fd, writer.text.data(), writer.text.size());
+        ok = fclose(fd) == 0 && ok;
+        if (!ok || rename(temp.c_str(), path.c_str()) != 0) remove(temp.c_str());
+    }
+
+    struct Reader {
+        const Record *records;
+        uint64_t num_records, pos;
+        const char *text;
+        uint64_t text_size;
+        std::vector<Names::Name> names;
+        bool ok;
+    };
+
+    static Node *Read(Reader &reader) {
+        if (reader.pos >= reader.num_records) {
+            reader.ok = false;
+            return NULL;
+        }
+        const Record &record = reader.records[reader.pos++];
+        if (record.id > Parser::BLOCK || record.kids > reader.num_records - reader.pos) {
+            reader.ok = false;
+            return NULL;
+        }
+
+        Node *node = Parser::CreateNode((Parser::NodeId)record.id);
+        Parser::GetBeginInText(node) = record.begin_in_text;
+        Parser::GetEndInText(node) = record.end_in_text;
+
+        switch (record.id) {
+            case Parser::NAME: {
+                if (record.value >= reader.names.size()) {
+                    reader.ok = false;
+                    return node;
+                }
+                Parser::GetName(node) = reader.names[record.value];
+                break;
+            }
+            case Parser::BOOL_LITERAL: {
+                Parser::GetBool(node) = record.value != 0;
+                break;
+            }
+            case Parser::CHAR_LITERAL: {
+                Parser::GetChar(node) = (CHAR_T)record.value;
+                break;
+            }
+            case Parser::INT_LITERAL: {
+                memcpy(&Parser::GetInt(node), &record.value, sizeof(record.value));
+                break;
+            }
+            case Parser::REAL_LITERAL: {
+                memcpy(&Parser::GetReal(node), &record.value, sizeof(record.value));
+                break;
+            }
+            case Parser::STRING_LITERAL: {
+                if (record.value > reader.text_size || record.size > reader.text_size - record.value) {
+                    reader.ok = false;
+                    return node;
+                }
+                Parser::GetString(node).assign(reader.text + record.value, record.size);
+                break;
+            }
+            default: break;
+        }
+
+        std::vector<Node*> &kids = Parser::GetKids(node);
+        kids.reserve(record.kids);
+        for (uint32_t i = 0; i < record.kids && reader.ok; i++) {
+            Node *kid = Read(reader);
+            if (kid != NULL) kids.push_back(kid);
+        }
+        return node;
+    }
+
+    static bool Parse(const Tokenizer::Source &cache, const Tokenizer::Source &source, std::vector<Node*> &forms) {
+        Header header;
+        if (cache.size < sizeof(header)) return false;
+        memcpy(&header, cache.data, sizeof(header));
+        if (memcmp(header.magic, magic, sizeof(magic)) != 0) return false;
+        if (header.version != format_version || header.record_size != sizeof(Record)) return false;
+        if (header.num_node_ids != num_node_ids || header.num_keywords != num_keywords) return false;
+        if (header.build_id != BuildId()) return false;
+        if (header.source_size != source.size || header.source_hash != SourceHash(source)) return false;
+
+        uint64_t left = cache.size - sizeof(header);
+        if (header.num_names > left / sizeof(NameEntry)) return false;
+        left -= header.num_names * sizeof(NameEntry);
+        if (header.num_records > left / sizeof(Record)) return false;
+        left -= header.num_records * sizeof(Record);
+        if (header.text_size != left) return false;
+
+        const char *data = cache.data + sizeof(header);
+        const NameEntry *names = (const NameEntry*)data;
+        data += header.num_names * sizeof(NameEntry);
+        Reader reader{(const Record*)data, header.num_records, 0,
+                      data + header.num_records * sizeof(Record), header.text_size, {}, true};
+
+        reader.names.reserve(header.num_names);
+        for (uint64_t i = 0; i < header.num_names; i++) {
+            if (names[i].offset > reader.text_size || names[i].size > reader.text_size - names[i].offset) return false;
+            reader.names.push_back(Names::GetName(std::string_view(reader.text + names[i].offset, names[i].size)));
+        }
+
+        size_t first = forms.size();
+        for (uint64_t i = 0; i < header.num_forms && reader.ok; i++) {
+            Node *form = Read(reader);
+            if (form != NULL) forms.push_back(form);
+        }
+        if (!reader.ok || reader.pos != reader.num_records) {
+            // the nodes read so far are dropped, the script is parsed from the source instead
+            for (size_t i = first; i < forms.size(); i++) Parser::Destroy(forms[i]);
+            forms.resize(first);
+            return false;
+        }
+        return true;
+    }
+
+    bool Load(const std::string &file, const Tokenizer::Source &source, std::vector<Node*> &forms) {
+        if (!source.mapped || BuildId() == 0) return false;
+
+        Tokenizer::Source cache;
+        if (!Tokenizer::Load(CachePath(file).c_str(), cache)) return false;
+        bool ok = Parse(cache, source, forms);
+        Tokenizer::Unload(cache);
+        return ok;
+    }
+}
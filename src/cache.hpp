@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "util.hpp"
+#include "tokenizer.hpp"
+
+namespace Cache {
+    // reads the parsed top-level forms of the script from file + ".cache", if it is up to date
+    bool Load(const std::string &file, const Tokenizer::Source &source, std::vector<Node*> &forms);
+    // writes them there, errors are ignored
+    void Store(const std::string &file, const Tokenizer::Source &source, const std::vector<Node*> &forms);
+
+    /*
+
+    the cache is keyed by the size and the hash of the source, by the format version and by a hash
+    of the interpreter's executable, so an edited script or a rebuilt interpreter ignores and rewrites it.
+    forms are stored before they are resolved, as a pre-order list of fixed size records.
+    only regular files are cached
+
+    */
+}
@@ -0,0 +1,655 @@
+#include "compiler.hpp"
+
+#include <vector>
+
+#include "parser.hpp"
+#include "objects.hpp"
+
+namespace Compiler {
+    /*
+
+    control flow of Parser::Execute is reproduced with jumps.
+
+    continue, break and return only have effect when they are placed in a statement position:
+    inside of a block, in a body of a loop or in a branch of an if. any other place is a boundary,
+    where the flags are dropped. a block, a loop or an if that is placed on a boundary evaluates
+    to the returned value, or to NULL if nothing was returned.
+
+    every scope that is left through continue, break or return is destroyed with UNWIND.
+
+    each keeps its snapshot of the dict and its position on the stack while the loop runs.
+    return drops them with DROP, they are on the GC heap so nothing has to destroy them.
+
+    namespaces are opened where Resolver says they are, so that the addresses of names stay valid.
+
+    literals that are only read by an instruction are created once, when the code is compiled.
+    they are marked as referenceable so that nothing destroys them.
+
+    */
+    struct Loop {
+        int scopes; // scopes entered before the body of the loop
+        std::vector<int> continue_jumps, break_jumps;
+        int values; // values the loop keeps on the stack
+    };
+    struct Context {
+        int scopes; // scopes entered since the boundary
+        std::vector<Loop> loops;
+        std::vector<int> exit_jumps;
+    };
+
+    static Chunk *chunk;
+    static std::vector<Context> contexts;
+
+    static Context &Top() {
+        return contexts.back();
+    }
+
+    static void CompileExpr(Node *node);
+    static void CompileStmt(Node *node);
+
+    static int Emit(OpCode op, Node *node, int arg = 0) {
+        Instruction ins;
+        ins.op = op;
+        ins.arg = arg;
+        ins.begin_in_text = Parser::GetBeginInText(node);
+        ins.end_in_text = Parser::GetEndInText(node);
+        ins.int_literal = 0;
+        chunk->code.push_back(ins);
+        return chunk->code.size() - 1;
+    }
+    static int Here() {
+        return chunk->code.size();
+    }
+    static void Patch(std::vector<int> &jumps, int target) {
+        for (auto jump: jumps) chunk->code[jump].arg = target;
+        jumps.clear();
+    }
+
+    static void EmitError(Node *node, const char *message) {
+        int ins = Emit(ERROR, node);
+        chunk->code[ins].message = message;
+    }
+    static void EmitCheck(Node *node, int types, const char *message) {
+        int ins = Emit(CHECK_TYPE, node, types);
+        chunk->code[ins].message = message;
+    }
+    static void EmitEnterScope(Node *node) {
+        int ins = Emit(ENTER_SCOPE, node, Parser::GetScopeSize(node));
+        chunk->code[ins].bool_literal = Parser::GetCopiesArgs(node);
+    }
+
+    // checks the number of kids, emits an error instead of the node if it is wrong
+    static bool Arity(Node *node, int count, const char *message) {
+        if (Parser::GetKids(node).size() == count) return true;
+        EmitError(node, message);
+        return false;
+    }
+
+    static bool IsScope(Node *node) {
+        switch (Parser::GetId(node)) {
+            case Parser::WHILE:
+            case Parser::FOR:
+            case Parser::REPEAT:
+            case Parser::EACH:
+            case Parser::IF:
+            case Parser::BLOCK: return true;
+            default: return false;
+        }
+    }
+
+    // true if the node never evaluates to NULL
+    static bool IsValue(Node *node) {
+        switch (Parser::GetId(node)) {
+            case Parser::BOOL_LITERAL:
+            case Parser::CHAR_LITERAL:
+            case Parser::INT_LITERAL:
+            case Parser::REAL_LITERAL:
+            case Parser::STRING_LITERAL:
+            case Parser::NULL_LITERAL:
+            case Parser::DICT_LITERAL:
+            case Parser::NAME:
+            case Parser::BOOL_CAST:
+            case Parser::CHAR_CAST:
+            case Parser::INT_CAST:
+            case Parser::REAL_CAST:
+            case Parser::STRING_CAST:
+            case Parser::DEREF:
+            case Parser::REF:
+            case Parser::INV:
+            case Parser::NOT:
+            case Parser::NEG:
+            case Parser::MULT:
+            case Parser::DIV:
+            case Parser::REM:
+            case Parser::ADD:
+            case Parser::SUB:
+            case Parser::SHL:
+            case Parser::SHR:
+            case Parser::LT:
+            case Parser::GT:
+            case Parser::LE:
+            case Parser::GE:
+            case Parser::EQ:
+            case Parser::NEQ:
+            case Parser::AND:
+            case Parser::XOR:
+            case Parser::OR:
+            case Parser::CONJ:
+            case Parser::DISJ: return true;
+            default: return false;
+        }
+    }
+
+    static void CompileValue(Node *node) {
+        CompileExpr(node);
+        if (!IsValue(node)) Emit(CHECK_VALUE, node);
+    }
+
+    static Object *Constant(Node *node) {
+        Object *res;
+        switch (Parser::GetId(node)) {
+            case Parser::BOOL_LITERAL: {
+                res = Objects::Create(Objects::BOOL);
+                *Objects::GetBool(res) = Parser::GetBool(node);
+                break;
+            }
+            case Parser::CHAR_LITERAL: {
+                res = Objects::Create(Objects::CHAR);
+                *Objects::GetChar(res) = Parser::GetChar(node);
+                break;
+            }
+            case Parser::INT_LITERAL: {
+                res = Objects::Create(Objects::INT);
+                *Objects::GetInt(res) = Parser::GetInt(node);
+                break;
+            }
+            case Parser::REAL_LITERAL: {
+                res = Objects::Create(Objects::REAL);
+                *Objects::GetReal(res) = Parser::GetReal(node);
+                break;
+            }
+            case Parser::STRING_LITERAL: {
+                res = Objects::Copy(Parser::GetStringObject(node), false);
+                break;
+            }
+            default: return NULL;
+        }
+        Objects::MakeReferenceable(res);
+        return res;
+    }
+
+    // compiles a node whose value is only read and then dropped
+    static void CompileOperand(Node *node) {
+        Object *constant = Constant(node);
+        if (constant == NULL) {
+            CompileExpr(node);
+            return;
+        }
+        int ins = Emit(PUSH_CONST, node);
+        chunk->code[ins].constant = constant;
+    }
+    static void CompileOperandValue(Node *node) {
+        CompileOperand(node);
+        if (!IsValue(node)) Emit(CHECK_VALUE, node);
+    }
+
+    static void CompileBoundary(Node *node) {
+        contexts.push_back({0, {}, {}});
+        CompileStmt(node);
+        Emit(PUSH_NULL, node);
+        Patch(contexts.back().exit_jumps, Here());
+        contexts.pop_back();
+    }
+
+    static void CompileInScope(Node *node) {
+        if (Parser::GetId(node) == Parser::BLOCK || Parser::GetScopeSize(node) < 0) {
+            CompileStmt(node);
+            return;
+        }
+        EmitEnterScope(node);
+        Top().scopes++;
+        CompileStmt(node);
+        Top().scopes--;
+        Emit(LEAVE_SCOPE, node);
+    }
+
+    static void CompileJump(Node *node, bool is_break) {
+        Context &context = Top();
+        if (context.loops.empty()) {
+            if (context.scopes) Emit(UNWIND, node, context.scopes);
+            Emit(PUSH_NULL, node);
+            context.exit_jumps.push_back(Emit(JUMP, node));
+            return;
+        }
+
+        Loop &loop = context.loops.back();
+        if (context.scopes != loop.scopes) Emit(UNWIND, node, context.scopes - loop.scopes);
+        if (is_break) loop.break_jumps.push_back(Emit(JUMP, node));
+        else loop.continue_jumps.push_back(Emit(JUMP, node));
+    }
+
+    static void CompileSet(Node *node) {
+        std::vector<Node*> &kids = Parser::GetKids(node);
+        if (Parser::GetId(kids[0]) == Parser::NAME) {
+            CompileOperandValue(kids[1]);
+            int ins = Emit(STORE_NAME, node);
+            chunk->code[ins].addresses = &Parser::GetAddresses(kids[0]);
+            return;
+        }
+
+        CompileValue(kids[0]);
+        Emit(CHECK_REFERENCEABLE, kids[0]);
+        CompileOperandValue(kids[1]);
+        Emit(STORE, node);
+    }
+
+    static void CompileDictOp(Node *node, OpCode op, int count) {
+        std::vector<Node*> &kids = Parser::GetKids(node);
+        CompileExpr(kids[0]);
+        EmitCheck(kids[0], Objects::DICT, "Expected a dict value");
+        for (int i = 1; i < count; i++) CompileOperand(kids[i]);
+        Emit(op, node);
+    }
+
+    static void CompileStringOp(Node *node, OpCode op, int count) {
+        std::vector<Node*> &kids = Parser::GetKids(node);
+        CompileExpr(kids[0]);
+        EmitCheck(kids[0], Objects::STRING, "Expected a string value");
+        for (int i = 1; i < count; i++) CompileOperand(kids[i]);
+        Emit(op, node);
+    }
+
+    // compiles nodes which never have a value. returns false if the node is not one of them
+    static bool CompileEffect(Node *node) {
+        switch (Parser::GetId(node)) {
+            case Parser::SET: {
+                if (Arity(node, 2, "Expected 2 arguments")) CompileSet(node);
+                return true;
+            }
+            case Parser::DINSERT: {
+                if (Arity(node, 3, "Expected 3 arguments")) CompileDictOp(node, DINSERT, 3);
+                return true;
+            }
+            case Parser::DREMOVE: {
+                if (Arity(node, 2, "Expected 2 arguments")) CompileDictOp(node, DREMOVE, 2);
+                return true;
+            }
+            case Parser::DCLEAR: {
+                if (Arity(node, 1, "Expected 1 argument")) CompileDictOp(node, DCLEAR, 1);
+                return true;
+            }
+            case Parser::SADDSUF: {
+                if (Arity(node, 2, "Expected 2 arguments")) CompileStringOp(node, SADDSUF, 2);
+                return true;
+            }
+            case Parser::SADDPREF: {
+                if (Arity(node, 2, "Expected 2 arguments")) CompileStringOp(node, SADDPREF, 2);
+                return true;
+            }
+            case Parser::SREMOVESUF: {
+                if (Arity(node, 2, "Expected 2 arguments")) CompileStringOp(node, SREMOVESUF, 2);
+                return true;
+            }
+            case Parser::SREMOVEPREF: {
+                if (Arity(node, 2, "Expected 2 arguments")) CompileStringOp(node, SREMOVEPREF, 2);
+                return true;
+            }
+            default: return false;
+        }
+    }
+
+    static void CompileDiscard(Node *node) {
+        if (CompileEffect(node)) return;
+        CompileExpr(node);
+        Emit(POP, node);
+    }
+
+    static void CompileStmt(Node *node) {
+        std::vector<Node*> &kids = Parser::GetKids(node);
+
+        switch (Parser::GetId(node)) {
+            case Parser::BLOCK: {
+                // the body of a function and elided blocks have no namespace of their own
+                bool opens_scope = Parser::GetScopeSize(node) >= 0;
+                if (opens_scope) {
+                    EmitEnterScope(node);
+                    Top().scopes++;
+                }
+                for (auto kid: kids) CompileStmt(kid);
+                if (opens_scope) {
+                    Top().scopes--;
+                    Emit(LEAVE_SCOPE, node);
+                }
+                return;
+            }
+            case Parser::WHILE: {
+                if (!Arity(node, 2, "Expected 2 arguments")) return;
+
+                int cond = Here();
+                CompileOperand(kids[0]);
+                int exit = Emit(JUMP_IF_FALSE, kids[0]);
+                chunk->code[exit].message = "Expected bool value";
+
+                Top().loops.push_back({Top().scopes, {}, {}, 0});
+                CompileInScope(kids[1]);
+                Emit(JUMP, node, cond);
+
+                Loop &loop = Top().loops.back();
+                Patch(loop.continue_jumps, cond);
+                Patch(loop.break_jumps, Here());
+                chunk->code[exit].arg = Here();
+                Top().loops.pop_back();
+                return;
+            }
+            case Parser::FOR: {
+                if (!Arity(node, 4, "Expected 4 arguments")) return;
+
+                CompileDiscard(kids[0]);
+
+                int cond = Here();
+                CompileOperand(kids[1]);
+                int exit = Emit(JUMP_IF_FALSE, kids[1]);
+                chunk->code[exit].message = "Expected bool value";
+
+                Top().loops.push_back({Top().scopes, {}, {}, 0});
+                CompileInScope(kids[3]);
+
+                int step = Here();
+                CompileDiscard(kids[2]);
+                Emit(JUMP, node, cond);
+
+                Loop &loop = Top().loops.back();
+                Patch(loop.continue_jumps, step);
+                Patch(loop.break_jumps, Here());
+                chunk->code[exit].arg = Here();
+                Top().loops.pop_back();
+                return;
+            }
+            case Parser::REPEAT: {
+                if (!Arity(node, 2, "Expected 2 arguments")) return;
+
+                int body = Here();
+                Top().loops.push_back({Top().scopes, {}, {}, 0});
+                CompileInScope(kids[0]);
+
+                int cond = Here();
+                CompileOperand(kids[1]);
+                int exit = Emit(JUMP_IF_TRUE, kids[0]);
+                chunk->code[exit].message = "Expected bool value";
+                Emit(JUMP, node, body);
+
+                Loop &loop = Top().loops.back();
+                Patch(loop.continue_jumps, cond);
+                Patch(loop.break_jumps, Here());
+                chunk->code[exit].arg = Here();
+                Top().loops.pop_back();
+                return;
+            }
+            case Parser::EACH: {
+                if (!Arity(node, 4, "Expected 4 arguments")) return;
+                if (Parser::GetId(kids[0]) != Parser::NAME || Parser::GetId(kids[1]) != Parser::NAME) {
+                    EmitError(node, "Expected names for the key and the value");
+                    return;
+                }
+
+                CompileExpr(kids[2]);
+                EmitCheck(kids[2], Objects::DICT, "Expected a dict value");
+                Emit(EACH_START, node);
+
+                int next = Emit(EACH_NEXT, node);
+                int ins = Emit(BIND_NAME, kids[1]);
+                chunk->code[ins].addresses = &Parser::GetAddresses(kids[1]);
+                ins = Emit(BIND_NAME, kids[0]);
+                chunk->code[ins].addresses = &Parser::GetAddresses(kids[0]);
+
+                Top().loops.push_back({Top().scopes, {}, {}, 2});
+                CompileInScope(kids[3]);
+                Emit(JUMP, node, next);
+
+                Loop &loop = Top().loops.back();
+                Patch(loop.continue_jumps, next);
+                Patch(loop.break_jumps, Here());
+                chunk->code[next].arg = Here();
+                Emit(EACH_END, node);
+                Top().loops.pop_back();
+                return;
+            }
+            case Parser::IF: {
+                if (!Arity(node, 3, "Expected 3 arguments")) return;
+
+                CompileOperand(kids[0]);
+                int otherwise = Emit(JUMP_IF_FALSE, kids[0]);
+                chunk->code[otherwise].message = "Expected bool value";
+
+                CompileInScope(kids[1]);
+                int exit = Emit(JUMP, node);
+
+                chunk->code[otherwise].arg = Here();
+                CompileInScope(kids[2]);
+                chunk->code[exit].arg = Here();
+                return;
+            }
+            case Parser::CONTINUE: {
+                CompileJump(node, false);
+                return;
+            }
+            case Parser::BREAK: {
+                CompileJump(node, true);
+                return;
+            }
+            case Parser::RETURN: {
+                if (kids.size() > 1) {
+                    EmitError(node, "Expected at most 1 argument");
+                    return;
+                }
+                int values = 0;
+                for (auto &loop: Top().loops) values += loop.values;
+                if (values) Emit(DROP, node, values);
+
+                if (kids.empty()) Emit(PUSH_NULL, node);
+                else CompileExpr(kids[0]);
+
+                Emit(RETURN_OUT, node, Top().scopes);
+                Top().exit_jumps.push_back(Emit(JUMP, node));
+                return;
+            }
+            default: {
+                CompileDiscard(node);
+                return;
+            }
+        }
+    }
+
+    static void CompileExpr(Node *node) {
+        std::vector<Node*> &kids = Parser::GetKids(node);
+        Parser::NodeId id = Parser::GetId(node);
+
+        if (IsScope(node)) {
+            CompileBoundary(node);
+            return;
+        }
+        if (CompileEffect(node)) {
+            Emit(PUSH_NULL, node);
+            return;
+        }
+
+        switch (id) {
+            case Parser::CONTINUE:
+            case Parser::BREAK: {
+                Emit(PUSH_NULL, node);
+                return;
+            }
+            case Parser::RETURN: {
+                if (kids.size() > 1) EmitError(node, "Expected at most 1 argument");
+                else if (kids.empty()) Emit(PUSH_NULL, node);
+                else CompileExpr(kids[0]);
+                return;
+            }
+            case Parser::FUNC: {
+                if (!Arity(node, 1, "Expected 1 argument")) return;
+                int ins = Emit(MAKE_FUNC, node);
+                chunk->code[ins].node = kids[0];
+                return;
+            }
+            case Parser::ARG: {
+                if (!Arity(node, 1, "Expected 1 argument")) return;
+                CompileOperand(kids[0]);
+                EmitCheck(kids[0], Objects::INT, "Argument index must be int");
+                Emit(ARG, node);
+                return;
+            }
+            case Parser::CALL: {
+                if (kids.size() < 1) {
+                    EmitError(node, "Expected at least 1 argument");
+                    return;
+                }
+                CompileExpr(kids[0]);
+                EmitCheck(kids[0], Objects::FUNCTION, "Expected a function value");
+                for (int i = 1; i < kids.size(); i++) CompileOperand(kids[i]);
+                Emit(CALL, node, kids.size() - 1);
+                return;
+            }
+            case Parser::BOOL_CAST:
+            case Parser::CHAR_CAST:
+            case Parser::INT_CAST:
+            case Parser::REAL_CAST:
+            case Parser::STRING_CAST: {
+                if (!Arity(node, 1, "Expected 1 argument")) return;
+                CompileOperand(kids[0]);
+                Emit((OpCode)(CAST_BOOL + (id - Parser::BOOL_CAST)), node);
+                return;
+            }
+            case Parser::DEREF: {
+                if (!Arity(node, 1, "Expected 1 argument")) return;
+                CompileExpr(kids[0]);
+                EmitCheck(kids[0], Objects::POINTER, "Expected a pointer value");
+                Emit(DEREF, node);
+                return;
+            }
+            case Parser::REF: {
+                if (!Arity(node, 1, "Expected 1 argument")) return;
+                CompileValue(kids[0]);
+                Emit(REF, node);
+                return;
+            }
+            case Parser::INV:
+            case Parser::NOT:
+            case Parser::NEG: {
+                if (!Arity(node, 1, "Expected 1 argument")) return;
+                CompileOperandValue(kids[0]);
+                Emit((OpCode)(INV + (id - Parser::INV)), node);
+                return;
+            }
+            case Parser::MULT:
+            case Parser::DIV:
+            case Parser::REM:
+            case Parser::ADD:
+            case Parser::SUB:
+            case Parser::SHL:
+            case Parser::SHR:
+            case Parser::LT:
+            case Parser::GT:
+            case Parser::LE:
+            case Parser::GE:
+            case Parser::EQ:
+            case Parser::NEQ:
+            case Parser::AND:
+            case Parser::XOR:
+            case Parser::OR:
+            case Parser::CONJ:
+            case Parser::DISJ: {
+                if (!Arity(node, 2, "Expected 2 arguments")) return;
+                CompileOperandValue(kids[0]);
+                CompileOperandValue(kids[1]);
+                Emit((OpCode)(MULT + (id - Parser::MULT)), node);
+                return;
+            }
+            case Parser::DACCESS: {
+                if (Arity(node, 2, "Expected 2 arguments")) CompileDictOp(node, DACCESS, 2);
+                return;
+            }
+            case Parser::DSIZE: {
+                if (Arity(node, 1, "Expected 1 argument")) CompileDictOp(node, DSIZE, 1);
+                return;
+            }
+            case Parser::DPRESENT: {
+                if (Arity(node, 2, "Expected 2 arguments")) CompileDictOp(node, DPRESENT, 2);
+                return;
+            }
+            case Parser::DKEYS: {
+                if (Arity(node, 1, "Expected 1 argument")) CompileDictOp(node, DKEYS, 1);
+                return;
+            }
+            case Parser::DVALUES: {
+                if (Arity(node, 1, "Expected 1 argument")) CompileDictOp(node, DVALUES, 1);
+                return;
+            }
+            case Parser::SACCESS: {
+                if (Arity(node, 2, "Expected 2 arguments")) CompileStringOp(node, SACCESS, 2);
+                return;
+            }
+            case Parser::SSIZE: {
+                if (Arity(node, 1, "Expected 1 argument")) CompileStringOp(node, SSIZE, 1);
+                return;
+            }
+            case Parser::BOOL_LITERAL: {
+                int ins = Emit(PUSH_BOOL, node);
+                chunk->code[ins].bool_literal = Parser::GetBool(node);
+                return;
+            }
+            case Parser::CHAR_LITERAL: {
+                int ins = Emit(PUSH_CHAR, node);
+                chunk->code[ins].char_literal = Parser::GetChar(node);
+                return;
+            }
+            case Parser::INT_LITERAL: {
+                int ins = Emit(PUSH_INT, node);
+                chunk->code[ins].int_literal = Parser::GetInt(node);
+                return;
+            }
+            case Parser::REAL_LITERAL: {
+                int ins = Emit(PUSH_REAL, node);
+                chunk->code[ins].real_literal = Parser::GetReal(node);
+                return;
+            }
+            case Parser::STRING_LITERAL: {
+                int ins = Emit(PUSH_STRING, node);
+                chunk->code[ins].constant = Parser::GetStringObject(node);
+                return;
+            }
+            case Parser::NULL_LITERAL: {
+                Emit(PUSH_POINTER, node);
+                return;
+            }
+            case Parser::DICT_LITERAL: {
+                Emit(PUSH_DICT, node);
+                return;
+            }
+            case Parser::NAME: {
+                int ins = Emit(LOAD_NAME, node);
+                chunk->code[ins].arg = Parser::GetName(node).id;
+                chunk->code[ins].addresses = &Parser::GetAddresses(node);
+                return;
+            }
+            default: {
+                Emit(PUSH_NULL, node);
+                return;
+            }
+        }
+    }
+
+    Chunk *Compile(Node *node) {
+        chunk = new Chunk;
+        contexts.push_back({0, {}, {}});
+        CompileExpr(node);
+        Emit(RET, node);
+        contexts.pop_back();
+        return chunk;
+    }
+    void Destroy(Chunk *chunk) {
+        for (auto &ins: chunk->code) {
+            if (ins.op == PUSH_CONST) Objects::Destroy(ins.constant);
+        }
+        delete chunk;
+    }
+}
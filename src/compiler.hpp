@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include "util.hpp"
+#include "namespaces.hpp"
+#include "objects.hpp"
+
+namespace Compiler {
+    enum OpCode {
+        PUSH_NULL, PUSH_CONST, PUSH_BOOL, PUSH_CHAR, PUSH_INT, PUSH_REAL, PUSH_STRING, PUSH_POINTER, PUSH_DICT,
+        LOAD_NAME, STORE_NAME, BIND_NAME, STORE, CHECK_VALUE, CHECK_REFERENCEABLE, CHECK_TYPE, POP,
+        JUMP, JUMP_IF_FALSE, JUMP_IF_TRUE, ENTER_SCOPE, LEAVE_SCOPE, UNWIND, RETURN_OUT, DROP,
+        EACH_START, EACH_NEXT, EACH_END,
+        MAKE_FUNC, ARG, CALL, CAST_BOOL, CAST_CHAR, CAST_INT, CAST_REAL, CAST_STRING, DEREF, REF,
+        INV, NOT, NEG, MULT, DIV, REM, ADD, SUB, SHL, SHR, LT, GT, LE, GE, EQ, NEQ, AND, XOR, OR,
+        CONJ, DISJ, DACCESS, DSIZE, DPRESENT, DINSERT, DREMOVE, DKEYS, DVALUES, DCLEAR,
+        SACCESS, SSIZE, SADDSUF, SADDPREF, SREMOVESUF, SREMOVEPREF, ERROR, RET
+    };
+
+    struct Instruction {
+        OpCode op;
+        int arg; // jump target, number of arguments, number of scopes, number of slots, a type mask or a name id
+        int begin_in_text, end_in_text; // highlighted if the instruction fails
+        union {
+            BOOL_T bool_literal; // also whether ENTER_SCOPE copies the arguments
+            CHAR_T char_literal;
+            INT_T int_literal;
+            REAL_T real_literal;
+            const char *message;
+            Node *node;
+            Object *constant;
+            const std::vector<Namespaces::Address> *addresses;
+        };
+    };
+
+    /*
+
+    a node is compiled as a function body (or a top-level form, which is the same thing).
+    the result of RET is what Parser::Execute would have returned for that node.
+
+    bodies of functions created inside of the node are not compiled here,
+    they are compiled when they are called for the first time.
+
+    */
+    Chunk *Compile(Node *node);
+    void Destroy(Chunk *chunk);
+}
+
+struct Chunk {
+    std::vector<Compiler::Instruction> code;
+};
@@ -1,35 +1,47 @@
 #include "custom_types.hpp"
 
-#include <unordered_map>
-#include <unordered_set>
+#include <vector>
+#include <algorithm>
 #include <iostream>
+#include <thread>
+#include <cmath>
 
 #include "objects.hpp"
 #include "parser.hpp"
 #include "errors.hpp"
 #include "hashing.hpp"
-
-#define MAX(A, B) (((A)>(B))?(A):(B))
+#include "vm.hpp"
+#include "pool.hpp"
+#include "gc.hpp"
 
 namespace CustomTypes {
-    struct DictKey {
-        Object *obj;
-        bool operator==(const DictKey &other) const {
-            return Objects::Equal(obj, other.obj);
-        }
+    enum ViewKind {
+        KEYS_VIEW, VALUES_VIEW, SNAPSHOT
     };
-    struct DictKeyHasher {
-        uint64_t operator()(const DictKey &key) const {
-            return Objects::Hash(key.obj);
-        }
+    struct DictEntry {
+        uint64_t hash; // hash of the key, computed once when the entry is inserted
+        Object *key; // NULL if the entry has been removed
+        Object *val;
     };
 }
 
 struct DICT_T {
-    std::unordered_map<CustomTypes::DictKey, Object*, CustomTypes::DictKeyHasher> map;
-    std::unordered_set<Object*> items;
-    uint64_t current_ops;
-    uint64_t target_ops;
+    std::vector<CustomTypes::DictEntry> entries; // in insertion order
+    std::vector<int32_t> index; // positions of entries, open addressing with linear probing
+    int size = 0; // entries that haven't been removed
+    bool is_dense = true; // keys are ints 0, 1, ..., size - 1 in this order, index is unused
+
+    DICT_T *source = NULL; // if the dict is a view, it has no entries of its own
+    CustomTypes::ViewKind view_kind;
+    std::vector<DICT_T*> views; // views of this dict
+    bool is_orphan = false; // the object holding the dict is gone, the dict is only kept for its views
+};
+
+struct ARRAY_T {
+    int refs = 1; // number of array objects sharing the elements
+    bool is_real;
+    std::vector<INT_T> ints; // elements of an int array
+    std::vector<REAL_T> reals; // elements of a real array
 };
 
 struct FUNC_T {
@@ -42,162 +54,657 @@ namespace CustomTypes {
     /*
     
     dict stores copies of keys and values passed to it.
-    therefore, when destroyed, it simply destroyes all of the items it has
+    the copies are put on the heap. keys never leave the dict, so the key of a removed entry is freed at once.
+    a value may still be used after its entry is removed, so it is left to GC.
+    inserting an existing key overwrites its value in place.
+
+    entries are kept in a vector, the hash table only stores their positions.
+    the size of the table is 0 or a power of 2, and it is at most 3/4 full (counting removed entries).
+    a removed entry stays in the vector until the table is rebuilt.
+
+    [dk] and [dv] return views: a view lists the keys or the values of its source by position,
+    entry i of the source being its key i. nothing is copied when a view is created.
+    reading an element of a view gives a copy of it, like the old copying [dk] and [dv] did, but one at a time.
+    a snapshot is a view of all entries, used to iterate over them. it is only read by DictEntryAt.
+    a view gets entries of its own (it is materialized) before it or its source is modified.
+    if the source is destroyed first, it is kept until its views are gone.
+
+    a dict whose keys are the ints 0, 1, ..., n - 1, inserted in this order, is dense:
+    key i is entry i, so it is found without hashing or probing.
+    it stops being dense on the first insert or removal that breaks this, and stays hashed until it is cleared.
 
     */
 
-    // kind of a garbage collection cycle
-    static void DictOp(DICT_T *dict) {
-        dict->current_ops++;
-        if (dict->current_ops == dict->target_ops) {
-            dict->current_ops = 0;
+    static const int32_t empty_pos = -1, removed_pos = -2;
+
+    // returns the cell of the table which holds the key, or -1
+    static int FindCell(DICT_T *dict, Object *key, uint64_t hash) {
+        if (dict->index.empty()) return -1;
+        uint64_t mask = dict->index.size() - 1;
+        for (uint64_t cell = hash & mask;; cell = (cell + 1) & mask) {
+            int32_t pos = dict->index[cell];
+            if (pos == empty_pos) return -1;
+            if (pos == removed_pos) continue;
+            DictEntry &entry = dict->entries[pos];
+            if (entry.hash == hash && Objects::Equal(entry.key, key)) return cell;
+        }
+    }
+    static void PutCell(DICT_T *dict, uint64_t hash, int32_t pos) {
+        uint64_t mask = dict->index.size() - 1;
+        uint64_t cell = hash & mask;
+        while (dict->index[cell] >= 0) cell = (cell + 1) & mask;
+        dict->index[cell] = pos;
+    }
+    // returns the position of the key in entries, or -1
+    static int FindPos(DICT_T *dict, Object *key) {
+        if (dict->is_dense) {
+            if (Objects::GetType(key) != Objects::INT) return -1;
+            INT_T i = *Objects::GetInt(key);
+            return 0 <= i && i < dict->size ? i : -1;
+        }
+        int cell = FindCell(dict, key, Objects::Hash(key));
+        return cell < 0 ? -1 : dict->index[cell];
+    }
+    // drops removed entries and makes the table large enough for one more entry
+    static void Rebuild(DICT_T *dict) {
+        int live = 0;
+        for (auto &entry: dict->entries) {
+            if (entry.key != NULL) dict->entries[live++] = entry;
+        }
+        dict->entries.resize(live);
+
+        size_t cells = 8;
+        while ((live + 1) * 4 > cells * 3) cells *= 2;
+        dict->index.assign(cells, empty_pos);
+        for (int i = 0; i < live; i++) PutCell(dict, dict->entries[i].hash, i);
+    }
 
-            std::unordered_set<Object*> present_items;
-            for (auto [key, val]: dict->map) {
-                present_items.insert(key.obj);
-                present_items.insert(val);
+    // adds an entry for a key which isn't in the dict
+    static void Append(DICT_T *dict, uint64_t hash, Object *key, Object *val) {
+        if (dict->is_dense) {
+            if (Objects::GetType(key) == Objects::INT && *Objects::GetInt(key) == dict->size) {
+                dict->entries.push_back({hash, key, val});
+                dict->size++;
+                return;
             }
+            dict->is_dense = false;
+            Rebuild(dict);
+        }
+        if ((dict->entries.size() + 1) * 4 > dict->index.size() * 3) Rebuild(dict);
+        dict->entries.push_back({hash, key, val});
+        PutCell(dict, hash, dict->entries.size() - 1);
+        dict->size++;
+    }
+
+    static int ViewPos(DICT_T *view, Object *key) {
+        if (Objects::GetType(key) != Objects::INT) return -1;
+        INT_T i = *Objects::GetInt(key);
+        return 0 <= i && i < view->source->size ? i : -1;
+    }
+    static void Unlink(DICT_T *view) {
+        DICT_T *source = view->source;
+        view->source = NULL;
+        source->views.erase(std::find(source->views.begin(), source->views.end(), view));
+        if (source->is_orphan && source->views.empty()) Pool::Delete(source);
+    }
+    static void Materialize(DICT_T *view) {
+        if (view->source == NULL) return;
+        DICT_T *source = view->source;
+        for (int i = 0; i < source->size; i++) {
+            DictEntry &entry = source->entries[i];
+            if (view->view_kind == SNAPSHOT) {
+                Object *key = Objects::Copy(entry.key, false);
+                Object *val = Objects::Copy(entry.val, true);
 
-            for (auto item: dict->items) {
-                if (present_items.find(item) == present_items.end()) {
-                    Objects::Destroy(item);
-                }
+                Append(view, entry.hash, key, val);
+                GC::Register(key);
+                GC::Register(val);
+                continue;
             }
+            Object *index = Objects::Create(Objects::INT);
+            *Objects::GetInt(index) = i;
+            Object *obj = Objects::Copy(view->view_kind == VALUES_VIEW ? entry.val : entry.key, true);
 
-            dict->items = present_items;
-            dict->target_ops = MAX(10000, present_items.size() * 2);
+            Append(view, Objects::Hash(index), index, obj);
+            GC::Register(index);
+            GC::Register(obj);
         }
+        Unlink(view);
+    }
+    static DICT_T *CreateView(DICT_T *source, ViewKind view_kind) {
+        Materialize(source);
+        if (source->entries.size() != source->size) Rebuild(source); // entry i has to be the i-th key
+        DICT_T *res = Pool::New<DICT_T>();
+        res->source = source;
+        res->view_kind = view_kind;
+        source->views.push_back(res);
+        return res;
+    }
+    // called before the dict is modified
+    static void PrepareWrite(DICT_T *dict) {
+        Materialize(dict);
+        while (!dict->views.empty()) Materialize(dict->views.back());
     }
 
     DICT_T *DictCreate() {
-        DICT_T *res = new DICT_T;
-        res->current_ops = 0;
-        res->target_ops = 10000;
-        return res;
+        return Pool::New<DICT_T>();
     }
     void DictDestroy(DICT_T *dict) {
-        for (auto item: dict->items) {
-            Objects::Destroy(item);
+        if (dict->source != NULL) Unlink(dict);
+        if (!dict->views.empty()) {
+            dict->is_orphan = true;
+            return;
         }
-        delete dict;
+        Pool::Delete(dict);
     }
     DICT_T *DictCopy(DICT_T *dict) {
+        if (dict->source != NULL) return CreateView(dict->source, dict->view_kind);
         DICT_T *res = DictCreate();
-        for (auto [key, val]: dict->map) {
-            DictKey new_key;
-            new_key.obj = Objects::Copy(key.obj, false);
-            Object *new_val = Objects::Copy(val, true);
-
-            res->map[new_key] = new_val;
-            res->items.insert(new_key.obj);
-            res->items.insert(new_val);
+        res->entries = dict->entries;
+        res->index = dict->index;
+        res->size = dict->size;
+        res->is_dense = dict->is_dense;
+        for (auto &entry: res->entries) {
+            if (entry.key == NULL) continue;
+            entry.key = Objects::Copy(entry.key, false);
+            entry.val = Objects::Copy(entry.val, true);
+            GC::Register(entry.key);
+            GC::Register(entry.val);
         }
         return res;
     }
+    void DictMark(DICT_T *dict) {
+        if (dict->source != NULL) dict = dict->source;
+        for (auto &entry: dict->entries) {
+            GC::Mark(entry.key);
+            GC::Mark(entry.val);
+        }
+    }
 
     Object *DictAccess(DICT_T *dict, Object *key) {
-        DictOp(dict);
-        if (dict->map.find({key}) != dict->map.end()) {
-            return dict->map[{key}];
+        if (dict->source != NULL && dict->view_kind == SNAPSHOT) Materialize(dict);
+        if (dict->source != NULL) {
+            int pos = ViewPos(dict, key);
+            if (pos < 0) RuntimeError("Key not present in dict");
+            DictEntry &entry = dict->source->entries[pos];
+            Object *res = Objects::Copy(dict->view_kind == VALUES_VIEW ? entry.val : entry.key, true);
+            GC::Register(res);
+            return res;
         }
-        RuntimeError("Key not present in dict");
-        return NULL;
+        int pos = FindPos(dict, key);
+        if (pos < 0) RuntimeError("Key not present in dict");
+        return dict->entries[pos].val;
     }
     int DictSize(DICT_T *dict) {
-        DictOp(dict);
-        return dict->map.size();
+        if (dict->source != NULL) return dict->source->size;
+        return dict->size;
     }
     bool DictPresent(DICT_T *dict, Object *key) {
-        DictOp(dict);
-        return dict->map.find({key}) != dict->map.end();
+        if (dict->source != NULL && dict->view_kind == SNAPSHOT) Materialize(dict);
+        if (dict->source != NULL) return ViewPos(dict, key) >= 0;
+        return FindPos(dict, key) >= 0;
     }
     void DictInsert(DICT_T *dict, Object *key, Object *val) {
-        DictOp(dict);
-        val = Objects::Copy(val, true);
-        if (!DictPresent(dict, key)) {
-            key = Objects::Copy(key, false);
-            dict->items.insert(key);
+        PrepareWrite(dict);
+        int pos = FindPos(dict, key);
+        if (pos >= 0) {
+            // the value is overwritten in place, so no garbage is left behind
+            Objects::ReplaceWithCopy(dict->entries[pos].val, val, true);
+            return;
         }
-        dict->map[{key}] = val;
-
-        dict->items.insert(val);
+        val = Objects::Copy(val, true);
+        GC::Register(val);
+        key = Objects::Copy(key, false);
+        GC::Register(key);
+        Append(dict, Objects::Hash(key), key, val);
     }
     void DictRemove(DICT_T *dict, Object *key) {
-        DictOp(dict);
-        if (!DictPresent(dict, key)) return;
-        dict->map.erase({key});
+        PrepareWrite(dict);
+        if (dict->is_dense) {
+            int pos = FindPos(dict, key);
+            if (pos < 0) return;
+            if (pos == dict->size - 1) {
+                GC::Free(dict->entries[pos].key);
+                dict->entries.pop_back();
+                dict->size--;
+                return;
+            }
+            dict->is_dense = false;
+            Rebuild(dict);
+        }
+        int cell = FindCell(dict, key, Objects::Hash(key));
+        if (cell < 0) return;
+        DictEntry &entry = dict->entries[dict->index[cell]];
+        GC::Free(entry.key);
+        entry.key = NULL;
+        entry.val = NULL;
+        dict->index[cell] = removed_pos;
+        dict->size--;
     }
     DICT_T *DictKeys(DICT_T *dict) {
-        DictOp(dict);
-        DICT_T *res = DictCreate();
-        int i = 0;
-        for (auto [key, _]: dict->map) {
-            Object *index = Objects::Create(Objects::INT);
-            *Objects::GetInt(index) = i++;
-            Object *obj = Objects::Copy(key.obj, true);
-
-            res->map[{index}] = obj;
-            res->items.insert(index);
-            res->items.insert(obj);
-        }
-        return res;
+        return CreateView(dict, KEYS_VIEW);
     }
     DICT_T *DictValues(DICT_T *dict) {
-        DictOp(dict);
-        DICT_T *res = DictCreate();
-        int i = 0;
-        for (auto [_, val]: dict->map) {
-            Object *index = Objects::Create(Objects::INT);
-            *Objects::GetInt(index) = i++;
-            Object *obj = Objects::Copy(val, true);
-
-            res->map[{index}] = obj;
-            res->items.insert(index);
-            res->items.insert(obj);
-        }
-        return res;
+        return CreateView(dict, VALUES_VIEW);
+    }
+    DICT_T *DictSnapshot(DICT_T *dict) {
+        return CreateView(dict, SNAPSHOT);
+    }
+    bool DictEntryAt(DICT_T *dict, int pos, Object *&key, Object *&val) {
+        // entries of a snapshot have no gaps, whether they belong to its source or to the snapshot itself
+        DICT_T *owner = dict->source != NULL ? dict->source : dict;
+        if (pos >= owner->size) return false;
+        key = owner->entries[pos].key;
+        val = owner->entries[pos].val;
+        return true;
     }
     std::string DictString(DICT_T *dict) {
+        Materialize(dict);
         std::string res = "{";
         bool f = true;
-        for (auto [key, val]: dict->map) {
+        for (auto &entry: dict->entries) {
+            if (entry.key == NULL) continue;
             if (!f) res += ", ";
-            res += Objects::AsString(key.obj);
+            res += Objects::AsString(entry.key);
             res += ": ";
-            res += Objects::AsString(val);
+            res += Objects::AsString(entry.val);
             f = false;
         }
         res += "}";
         return res;
     }
     bool DictEqual(DICT_T *first, DICT_T *second) {
-        if (first->map.size() != second->map.size()) return false;
-        for (auto [key, item]: first->map) {
-            if (second->map.find(key) == second->map.end()) return false;
-            if (!Objects::Equal(second->map[key], item)) return false;
-        }
-        for (auto [key, item]: second->map) {
-            if (first->map.find(key) == first->map.end()) return false;
-            if (!Objects::Equal(first->map[key], item)) return false;
+        Materialize(first);
+        Materialize(second);
+        if (first->size != second->size) return false;
+        // both dicts have the same number of keys, so every key of second is also found this way
+        for (auto &entry: first->entries) {
+            if (entry.key == NULL) continue;
+            int pos = FindPos(second, entry.key);
+            if (pos < 0) return false;
+            if (!Objects::Equal(second->entries[pos].val, entry.val)) return false;
         }
         return true;
     }
     void DictClear(DICT_T *first) {
-        for (auto item: first->items) Objects::Destroy(item);
-        first->map.clear();
-        first->items.clear();
-        first->current_ops = 0;
-        first->target_ops = 10000;
+        PrepareWrite(first);
+        for (auto &entry: first->entries) GC::Free(entry.key);
+        first->entries.clear();
+        first->index.clear();
+        first->size = 0;
+        first->is_dense = true;
     }
 
     const uint64_t dict_seed = 0x17ae3a7a33c2df17ul;
 
     uint64_t DictHash(DICT_T *dict) {
+        // entries are combined by addition, so equal dicts have equal hashes whatever their order is
+        Materialize(dict);
         uint64_t res = dict_seed;
-        for (auto [key, val]: dict->map) {
-            res = Hashing::Hash(res, Objects::Hash(key.obj));
-            res = Hashing::Hash(res, Objects::Hash(val));
+        for (auto &entry: dict->entries) {
+            if (entry.key == NULL) continue;
+            res += Hashing::Hash(entry.hash, Objects::Hash(entry.val));
+        }
+        return res;
+    }
+
+    // values of keys 0, 1, ..., n - 1. a view is read without being materialized
+    static void Elements(DICT_T *dict, std::vector<Object**> &res) {
+        if (dict->source != NULL && dict->view_kind != SNAPSHOT) {
+            for (auto &entry: dict->source->entries) res.push_back(dict->view_kind == VALUES_VIEW ? &entry.val : &entry.key);
+            return;
+        }
+        Materialize(dict);
+        if (dict->is_dense) {
+            for (auto &entry: dict->entries) res.push_back(&entry.val);
+            return;
+        }
+        Object *key = Objects::Create(Objects::INT);
+        for (int i = 0; i < dict->size; i++) {
+            *Objects::GetInt(key) = i;
+            int pos = FindPos(dict, key);
+            if (pos < 0) RuntimeError("Expected a dict with keys 0, 1, ..., n - 1");
+            res.push_back(&dict->entries[pos].val);
+        }
+        Objects::Destroy(key);
+    }
+    // returns INT, REAL or INT | REAL
+    static int NumberTypes(std::vector<Object**> &elements) {
+        int res = 0;
+        for (auto element: elements) res |= Objects::GetType(*element);
+        if (res & ~(Objects::INT | Objects::REAL)) RuntimeError("Expected int or real values");
+        return res;
+    }
+
+    static const size_t parallel_sort_size = 1 << 16;
+
+    // large inputs are split between threads, the sorted parts are then merged
+    template<typename T, typename Less>
+    static void Sort(std::vector<T> &vals, Less less) {
+        size_t threads = std::min(std::thread::hardware_concurrency(), 8u);
+        if (vals.size() < parallel_sort_size || threads < 2) {
+            std::sort(vals.begin(), vals.end(), less);
+            return;
+        }
+        size_t part = (vals.size() + threads - 1) / threads;
+        std::vector<std::thread> workers;
+        for (size_t begin = 0; begin < vals.size(); begin += part) {
+            size_t end = std::min(begin + part, vals.size());
+            workers.emplace_back([&vals, &less, begin, end]() {
+                std::sort(vals.begin() + begin, vals.begin() + end, less);
+            });
+        }
+        for (auto &worker: workers) worker.join();
+        for (size_t width = part; width < vals.size(); width *= 2) {
+            for (size_t begin = 0; begin + width < vals.size(); begin += 2 * width) {
+                size_t end = std::min(begin + 2 * width, vals.size());
+                std::inplace_merge(vals.begin() + begin, vals.begin() + begin + width, vals.begin() + end, less);
+            }
+        }
+    }
+    // the order of Objects::Less
+    struct NumberLess {
+        bool operator()(INT_T first, INT_T second) const {
+            return first < second;
+        }
+        bool operator()(REAL_T first, REAL_T second) const {
+            if (std::isnan(second)) return !std::isnan(first);
+            return first < second;
+        }
+    };
+    // numbers of a single type are sorted unboxed and written back into the same objects
+    template<typename T>
+    static void SortUnboxed(std::vector<Object**> &elements, T *(*get)(Object*)) {
+        std::vector<T> vals(elements.size());
+        for (size_t i = 0; i < elements.size(); i++) vals[i] = *get(*elements[i]);
+        Sort(vals, NumberLess());
+        for (size_t i = 0; i < elements.size(); i++) *get(*elements[i]) = vals[i];
+    }
+
+    void DictSort(DICT_T *dict) {
+        PrepareWrite(dict);
+        std::vector<Object**> elements;
+        Elements(dict, elements);
+        int types = NumberTypes(elements);
+        if (types == Objects::INT) return SortUnboxed(elements, Objects::GetInt);
+        if (types == Objects::REAL) return SortUnboxed(elements, Objects::GetReal);
+
+        std::vector<Object*> vals;
+        for (auto element: elements) vals.push_back(*element);
+        Sort(vals, Objects::Less);
+        for (size_t i = 0; i < elements.size(); i++) *elements[i] = vals[i];
+    }
+    void DictReverse(DICT_T *dict) {
+        PrepareWrite(dict);
+        std::vector<Object**> elements;
+        Elements(dict, elements);
+        for (size_t i = 0, j = elements.size(); i + 1 < j; i++, j--) std::swap(*elements[i], *elements[j - 1]);
+    }
+    int DictSearch(DICT_T *dict, Object *val) {
+        std::vector<Object**> elements;
+        Elements(dict, elements);
+        auto it = std::lower_bound(elements.begin(), elements.end(), val, [](Object **element, Object *val) {
+            return Objects::Less(*element, val);
+        });
+        if (it == elements.end() || Objects::Less(val, **it)) return -1;
+        return it - elements.begin();
+    }
+    Object *DictSum(DICT_T *dict) {
+        std::vector<Object**> elements;
+        Elements(dict, elements);
+        if (NumberTypes(elements) != Objects::INT) {
+            Object *res = Objects::Create(Objects::REAL);
+            for (auto element: elements) {
+                Object *val = *element;
+                *Objects::GetReal(res) += Objects::GetType(val) == Objects::INT ? *Objects::GetInt(val) : *Objects::GetReal(val);
+            }
+            return res;
+        }
+        Object *res = Objects::Create(Objects::INT);
+        for (auto element: elements) *Objects::GetInt(res) += *Objects::GetInt(*element);
+        return res;
+    }
+    Object *DictMin(DICT_T *dict) {
+        std::vector<Object**> elements;
+        Elements(dict, elements);
+        NumberTypes(elements);
+        if (elements.empty()) RuntimeError("Dict is empty");
+        Object *res = *elements[0];
+        for (auto element: elements) {
+            if (Objects::Less(*element, res)) res = *element;
+        }
+        return Objects::Copy(res, false);
+    }
+    Object *DictMax(DICT_T *dict) {
+        std::vector<Object**> elements;
+        Elements(dict, elements);
+        NumberTypes(elements);
+        if (elements.empty()) RuntimeError("Dict is empty");
+        Object *res = *elements[0];
+        for (auto element: elements) {
+            if (Objects::Less(res, *element)) res = *element;
+        }
+        return Objects::Copy(res, false);
+    }
+    void DictElements(DICT_T *dict, std::vector<Object*> &res) {
+        std::vector<Object**> elements;
+        Elements(dict, elements);
+        for (auto element: elements) res.push_back(*element);
+    }
+
+    /*
+
+    array stores ints or reals contiguously, without wrapping each element into an object.
+    copies share the elements until one of them is modified, like strings do.
+    bulk operations are plain loops over the elements, which the compiler can vectorize
+
+    */
+
+    template<typename T> static std::vector<T> &Elements(ARRAY_T *arr);
+    template<> std::vector<INT_T> &Elements(ARRAY_T *arr) { return arr->ints; }
+    template<> std::vector<REAL_T> &Elements(ARRAY_T *arr) { return arr->reals; }
+
+    static Object *Wrap(INT_T val) {
+        Object *res = Objects::Create(Objects::INT);
+        *Objects::GetInt(res) = val;
+        return res;
+    }
+    static Object *Wrap(REAL_T val) {
+        Object *res = Objects::Create(Objects::REAL);
+        *Objects::GetReal(res) = val;
+        return res;
+    }
+    static REAL_T RealValue(Object *val) {
+        if (Objects::GetType(val) == Objects::INT) return *Objects::GetInt(val);
+        if (Objects::GetType(val) == Objects::REAL) return *Objects::GetReal(val);
+        RuntimeError("Expected an int or a real value");
+        return 0;
+    }
+    static void CheckSameShape(ARRAY_T *first, ARRAY_T *second) {
+        if (first->is_real != second->is_real || ArraySize(first) != ArraySize(second))
+            RuntimeError("Expected arrays of the same type and size");
+    }
+
+    // four independent accumulators break the dependency between iterations,
+    // so the loop can be vectorized even for reals (which changes the order of additions)
+    template<typename T>
+    static T Sum(const T *a, size_t n) {
+        T acc[4] = {0, 0, 0, 0};
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            for (int j = 0; j < 4; j++) acc[j] += a[i + j];
+        }
+        for (; i < n; i++) acc[0] += a[i];
+        return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    }
+    template<typename T>
+    static T Dot(const T *a, const T *b, size_t n) {
+        T acc[4] = {0, 0, 0, 0};
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            for (int j = 0; j < 4; j++) acc[j] += a[i + j] * b[i + j];
+        }
+        for (; i < n; i++) acc[0] += a[i] * b[i];
+        return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    }
+    template<typename T, typename Op> // n > 0
+    static T Reduce(const T *a, size_t n, Op op) {
+        T acc[4] = {a[0], a[0], a[0], a[0]};
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            for (int j = 0; j < 4; j++) acc[j] = op(acc[j], a[i + j]);
         }
+        for (; i < n; i++) acc[0] = op(acc[0], a[i]);
+        return op(op(acc[0], acc[1]), op(acc[2], acc[3]));
+    }
+    template<typename T, typename Op>
+    static void Combine(T *__restrict res, const T *a, const T *b, size_t n, Op op) {
+        for (size_t i = 0; i < n; i++) res[i] = op(a[i], b[i]);
+    }
+    template<typename T, typename Op>
+    static ARRAY_T *Elementwise(ARRAY_T *first, ARRAY_T *second, Op op) {
+        CheckSameShape(first, second);
+        ARRAY_T *res = ArrayCreate(first->is_real, ArraySize(first));
+        Combine(Elements<T>(res).data(), Elements<T>(first).data(), Elements<T>(second).data(), Elements<T>(first).size(), op);
+        return res;
+    }
+
+    ARRAY_T *ArrayCreate(bool is_real, INT_T size) {
+        ARRAY_T *arr = Pool::New<ARRAY_T>();
+        arr->is_real = is_real;
+        if (is_real) arr->reals.resize(size);
+        else arr->ints.resize(size);
+        return arr;
+    }
+    void ArrayDestroy(ARRAY_T *arr) {
+        if (--arr->refs == 0) Pool::Delete(arr);
+    }
+    ARRAY_T *ArrayCopy(ARRAY_T *arr) {
+        arr->refs++;
+        return arr;
+    }
+    ARRAY_T *ArrayUnshare(ARRAY_T *arr) {
+        if (arr->refs == 1) return arr;
+        arr->refs--;
+        ARRAY_T *res = Pool::New<ARRAY_T>();
+        res->is_real = arr->is_real;
+        res->ints = arr->ints;
+        res->reals = arr->reals;
+        return res;
+    }
+
+    bool ArrayIsReal(ARRAY_T *arr) {
+        return arr->is_real;
+    }
+    INT_T ArraySize(ARRAY_T *arr) {
+        return arr->is_real ? arr->reals.size() : arr->ints.size();
+    }
+    Object *ArrayAccess(ARRAY_T *arr, INT_T pos) {
+        if (!(0 <= pos && pos < ArraySize(arr))) RuntimeError("Array access out of bounds");
+        if (arr->is_real) return Wrap(arr->reals[pos]);
+        return Wrap(arr->ints[pos]);
+    }
+    void ArraySet(ARRAY_T *arr, INT_T pos, Object *val) {
+        if (!(0 <= pos && pos < ArraySize(arr))) RuntimeError("Array access out of bounds");
+        if (arr->is_real) arr->reals[pos] = RealValue(val);
+        else {
+            if (Objects::GetType(val) != Objects::INT) RuntimeError("Expected an int value");
+            arr->ints[pos] = *Objects::GetInt(val);
+        }
+    }
+    void ArrayPush(ARRAY_T *arr, Object *val) {
+        if (arr->is_real) arr->reals.push_back(RealValue(val));
+        else {
+            if (Objects::GetType(val) != Objects::INT) RuntimeError("Expected an int value");
+            arr->ints.push_back(*Objects::GetInt(val));
+        }
+    }
+    Object *ArrayPop(ARRAY_T *arr) {
+        if (ArraySize(arr) == 0) RuntimeError("Array is empty");
+        Object *res = ArrayAccess(arr, ArraySize(arr) - 1);
+        if (arr->is_real) arr->reals.pop_back();
+        else arr->ints.pop_back();
+        return res;
+    }
+    ARRAY_T *ArraySlice(ARRAY_T *arr, INT_T begin, INT_T end) {
+        if (!(0 <= begin && begin <= end && end <= ArraySize(arr))) RuntimeError("Array slice out of bounds");
+        ARRAY_T *res = Pool::New<ARRAY_T>();
+        res->is_real = arr->is_real;
+        if (arr->is_real) res->reals.assign(arr->reals.begin() + begin, arr->reals.begin() + end);
+        else res->ints.assign(arr->ints.begin() + begin, arr->ints.begin() + end);
+        return res;
+    }
+    Object *ArraySum(ARRAY_T *arr) {
+        if (arr->is_real) return Wrap(Sum(arr->reals.data(), arr->reals.size()));
+        return Wrap(Sum(arr->ints.data(), arr->ints.size()));
+    }
+    Object *ArrayMin(ARRAY_T *arr) {
+        if (ArraySize(arr) == 0) RuntimeError("Array is empty");
+        auto op = [](auto a, auto b) { return b < a ? b : a; };
+        if (arr->is_real) return Wrap(Reduce(arr->reals.data(), arr->reals.size(), op));
+        return Wrap(Reduce(arr->ints.data(), arr->ints.size(), op));
+    }
+    Object *ArrayMax(ARRAY_T *arr) {
+        if (ArraySize(arr) == 0) RuntimeError("Array is empty");
+        auto op = [](auto a, auto b) { return a < b ? b : a; };
+        if (arr->is_real) return Wrap(Reduce(arr->reals.data(), arr->reals.size(), op));
+        return Wrap(Reduce(arr->ints.data(), arr->ints.size(), op));
+    }
+    Object *ArrayDot(ARRAY_T *first, ARRAY_T *second) {
+        CheckSameShape(first, second);
+        if (first->is_real) return Wrap(Dot(first->reals.data(), second->reals.data(), first->reals.size()));
+        return Wrap(Dot(first->ints.data(), second->ints.data(), first->ints.size()));
+    }
+    ARRAY_T *ArrayAdd(ARRAY_T *first, ARRAY_T *second) {
+        auto op = [](auto a, auto b) { return a + b; };
+        if (first->is_real) return Elementwise<REAL_T>(first, second, op);
+        return Elementwise<INT_T>(first, second, op);
+    }
+    ARRAY_T *ArrayMul(ARRAY_T *first, ARRAY_T *second) {
+        auto op = [](auto a, auto b) { return a * b; };
+        if (first->is_real) return Elementwise<REAL_T>(first, second, op);
+        return Elementwise<INT_T>(first, second, op);
+    }
+    ARRAY_T *ArrayScale(ARRAY_T *arr, Object *factor) {
+        if (!arr->is_real && Objects::GetType(factor) == Objects::INT) {
+            INT_T k = *Objects::GetInt(factor);
+            ARRAY_T *res = ArrayCreate(false, arr->ints.size());
+            INT_T *__restrict out = res->ints.data();
+            for (size_t i = 0; i < arr->ints.size(); i++) out[i] = arr->ints[i] * k;
+            return res;
+        }
+        REAL_T k = RealValue(factor);
+        ARRAY_T *res = ArrayCreate(true, ArraySize(arr));
+        REAL_T *__restrict out = res->reals.data();
+        if (arr->is_real) {
+            for (size_t i = 0; i < arr->reals.size(); i++) out[i] = arr->reals[i] * k;
+        }
+        else {
+            for (size_t i = 0; i < arr->ints.size(); i++) out[i] = arr->ints[i] * k;
+        }
+        return res;
+    }
+    std::string ArrayString(ARRAY_T *arr) {
+        std::string res = "[";
+        for (INT_T i = 0; i < ArraySize(arr); i++) {
+            if (i != 0) res += ", ";
+            res += arr->is_real ? std::to_string(arr->reals[i]) : std::to_string(arr->ints[i]);
+        }
+        res += "]";
+        return res;
+    }
+    bool ArrayEqual(ARRAY_T *first, ARRAY_T *second) {
+        if (first == second) return true;
+        return first->is_real == second->is_real && first->ints == second->ints && first->reals == second->reals;
+    }
+
+    const uint64_t array_seed = 0x5f1e2a7c93d4b601ul;
+
+    uint64_t ArrayHash(ARRAY_T *arr) {
+        if (!arr->is_real) return Hashing::HashBytes(array_seed, (const char*)arr->ints.data(), arr->ints.size() * sizeof(INT_T));
+        // reals are hashed like real objects, so values that compare equal have equal hashes
+        uint64_t res = array_seed;
+        for (auto val: arr->reals) res = Hashing::Hash(res, (uint64_t)val);
         return res;
     }
 
@@ -209,11 +716,11 @@ namespace CustomTypes {
     */
 
     FUNC_T *FuncCreate() {
-        FUNC_T *func = new FUNC_T;
+        FUNC_T *func = Pool::New<FUNC_T>();
         return func;
     }
     void FuncDestroy(FUNC_T *func) {
-        delete func;
+        Pool::Delete(func);
     }
     FUNC_T *FuncCopy(FUNC_T *func) {
         FUNC_T *res = FuncCreate();
@@ -231,6 +738,7 @@ namespace CustomTypes {
 
     Object *FuncCall(FUNC_T *func) {
         if (func->is_internal) return func->internal_ptr();
+        if (VM::Enabled()) return VM::Execute(func->node);
         bool do_continue = false, do_break = false, do_return = false;
         return Parser::Execute(func->node, do_continue, do_break, do_return);
     }
@@ -1,19 +1,23 @@
 #pragma once
 
+#include <vector>
+
 #include "objects.hpp"
 #include "parser.hpp"
 
 namespace CustomTypes {
     /*
     
-    dict stores copies of keys and values passed to it.
-    therefore, when destroyed, it simply destroyes all of the items it has
+    dict stores copies of keys and values passed to it, in insertion order.
+    they live on the heap and are freed by GC, destroying a dict only frees the dict itself.
+    keys of removed entries are freed right away, an existing value is overwritten in place
 
     */
 
     DICT_T *DictCreate();
     void DictDestroy(DICT_T *dict);
     DICT_T *DictCopy(DICT_T *dict); // deep copy
+    void DictMark(DICT_T *dict); // marks keys and values for GC
 
     Object *DictAccess(DICT_T *dict, Object *key);
     int DictSize(DICT_T *dict);
@@ -22,12 +26,58 @@ namespace CustomTypes {
     void DictRemove(DICT_T *dict, Object *key);
     DICT_T *DictKeys(DICT_T *dict);
     DICT_T *DictValues(DICT_T *dict);
+    // the entries the dict has now, in insertion order. they are read with DictEntryAt,
+    // and they don't change if the dict is modified later
+    DICT_T *DictSnapshot(DICT_T *dict);
+    bool DictEntryAt(DICT_T *snapshot, int pos, Object *&key, Object *&val); // returns false past the last entry
     std::string DictString(DICT_T *dict);
     bool DictEqual(DICT_T *first, DICT_T *second);
     void DictClear(DICT_T *first);
 
     uint64_t DictHash(DICT_T *dict);
 
+    // a dict with keys 0, 1, ..., n - 1 is treated as an array of its values, which must be ints or reals.
+    // they are compared like (lt A B) compares them
+    void DictSort(DICT_T *dict); // ascending, in place
+    void DictReverse(DICT_T *dict);
+    int DictSearch(DICT_T *dict, Object *val); // binary search in a sorted dict, returns the first key of an equal value or -1
+    Object *DictSum(DICT_T *dict);
+    Object *DictMin(DICT_T *dict);
+    Object *DictMax(DICT_T *dict);
+    void DictElements(DICT_T *dict, std::vector<Object*> &res); // values of keys 0, 1, ..., n - 1, of any type
+
+    /*
+
+    array stores ints or reals contiguously, without wrapping each element into an object.
+    copies share the elements until one of them is modified, like strings do.
+    bulk operations are plain loops over the elements, which the compiler can vectorize
+
+    */
+
+    ARRAY_T *ArrayCreate(bool is_real, INT_T size); // filled with zeros
+    void ArrayDestroy(ARRAY_T *arr);
+    ARRAY_T *ArrayCopy(ARRAY_T *arr); // shares the elements
+    ARRAY_T *ArrayUnshare(ARRAY_T *arr); // returns a private copy if the elements are shared, arr otherwise
+
+    bool ArrayIsReal(ARRAY_T *arr);
+    INT_T ArraySize(ARRAY_T *arr);
+    Object *ArrayAccess(ARRAY_T *arr, INT_T pos);
+    void ArraySet(ARRAY_T *arr, INT_T pos, Object *val);
+    void ArrayPush(ARRAY_T *arr, Object *val);
+    Object *ArrayPop(ARRAY_T *arr);
+    ARRAY_T *ArraySlice(ARRAY_T *arr, INT_T begin, INT_T end); // elements in [begin, end)
+    Object *ArraySum(ARRAY_T *arr);
+    Object *ArrayMin(ARRAY_T *arr);
+    Object *ArrayMax(ARRAY_T *arr);
+    Object *ArrayDot(ARRAY_T *first, ARRAY_T *second);
+    ARRAY_T *ArrayAdd(ARRAY_T *first, ARRAY_T *second); // elementwise
+    ARRAY_T *ArrayMul(ARRAY_T *first, ARRAY_T *second); // elementwise
+    ARRAY_T *ArrayScale(ARRAY_T *arr, Object *factor); // the result is real unless both are ints
+    std::string ArrayString(ARRAY_T *arr);
+    bool ArrayEqual(ARRAY_T *first, ARRAY_T *second);
+
+    uint64_t ArrayHash(ARRAY_T *arr);
+
     /*
     
     function is implemented as a pointer to a parse tree node.
@@ -13,7 +13,9 @@
 
 
 namespace Errors {
-    static int start, end;
+    // highlights are per thread, so threads that parse in parallel don't mix them up
+    static thread_local int start, end;
+    static thread_local bool deferred = false;
     std::string file;
 
     void SetFile(std::string f) {
@@ -45,19 +47,30 @@ namespace Errors {
         fd.close();
     }
 
+    void Defer(bool defer) {
+        deferred = defer;
+    }
+    void Report(const Deferred &error) {
+        Highlight(error.begin_in_text, error.end_in_text);
+        error.raise(error.message);
+    }
+
     void RuntimeError(std::string message) {
+        if (deferred) throw Deferred{RuntimeError, message, start, end};
         PrintTextNearby();
         std::cerr << "RuntimeError (" << start << "..." << end << "):\n";
         std::cerr << message << std::endl;
         exit(1);
     }
     void TokenizationError(std::string message) {
+        if (deferred) throw Deferred{TokenizationError, message, start, end};
         PrintTextNearby();
         std::cerr << "TokenizationError (" << start << "..." << end << "):\n";
         std::cerr << message << std::endl;
         exit(1);
     }
     void ParsingError(std::string message) {
+        if (deferred) throw Deferred{ParsingError, message, start, end};
         PrintTextNearby();
         std::cerr << "ParsingError (" << start << "..." << end << "):\n";
         std::cerr << message << std::endl;
@@ -8,6 +8,15 @@ namespace Errors {
     void RuntimeError(std::string message);
     void TokenizationError(std::string message);
     void ParsingError(std::string message);
+
+    // an error raised on a thread that defers errors, thrown instead of ending the program
+    struct Deferred {
+        void (*raise)(std::string message); // the function that raised it
+        std::string message;
+        int begin_in_text, end_in_text;
+    };
+    void Defer(bool defer); // for the calling thread
+    void Report(const Deferred &error);
 }
 
 using namespace Errors;
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "gc.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "objects.hpp"
+#include "namespaces.hpp"
+#include "vm.hpp"
+
+namespace GC {
+    static std::vector<Object*> heap;
+    static std::vector<Object*> gray; // marked objects which haven't been traced yet
+    static uint32_t epoch = 0;
+
+    static uint64_t min_heap = 100000;
+    static double growth = 2.0;
+    static uint64_t threshold = min_heap;
+
+    static Stats stats = {0, 0, 0, 0, 0};
+
+    void Register(Object *obj) {
+        if (obj == NULL) return;
+        Objects::HeapPos(obj) = heap.size();
+        heap.push_back(obj);
+    }
+    void Free(Object *obj) {
+        if (obj == NULL) return;
+        uint32_t pos = Objects::HeapPos(obj);
+        heap[pos] = heap.back();
+        Objects::HeapPos(heap[pos]) = pos;
+        heap.pop_back();
+        Objects::Destroy(obj);
+        stats.freed++;
+    }
+    void Mark(Object *obj) {
+        if (obj == NULL) return;
+        if (Objects::Mark(obj, epoch)) gray.push_back(obj);
+    }
+
+    void Poll() {
+        if (heap.size() >= threshold) Collect();
+    }
+    void Collect() {
+        auto start = std::chrono::steady_clock::now();
+        epoch++;
+
+        Namespaces::MarkRoots();
+        VM::MarkRoots();
+        while (!gray.empty()) {
+            Object *obj = gray.back();
+            gray.pop_back();
+            if (Objects::GetType(obj) == Objects::DICT) CustomTypes::DictMark(Objects::GetDict(obj));
+        }
+
+        int live = 0;
+        for (auto obj: heap) {
+            if (Objects::IsMarked(obj, epoch)) {
+                Objects::HeapPos(obj) = live;
+                heap[live++] = obj;
+            }
+            else Objects::Destroy(obj);
+        }
+        stats.freed += heap.size() - live;
+        heap.resize(live);
+        threshold = std::max(min_heap, (uint64_t)(live * growth));
+
+        double pause = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        stats.collections++;
+        stats.total_pause_ms += pause;
+        stats.max_pause_ms = std::max(stats.max_pause_ms, pause);
+    }
+
+    void Configure(uint64_t new_min_heap, double new_growth) {
+        min_heap = new_min_heap;
+        growth = new_growth;
+        threshold = std::max(min_heap, (uint64_t)(heap.size() * growth));
+    }
+
+    Stats GetStats() {
+        Stats res = stats;
+        res.heap = heap.size();
+        return res;
+    }
+    void PrintStats(std::ostream &out) {
+        Stats res = GetStats();
+        out << "gc: " << res.collections << " collections, " << res.freed << " objects freed, "
+            << res.heap << " objects on the heap\n";
+        out << "gc: " << res.total_pause_ms << " ms total pause, " << res.max_pause_ms << " ms max pause\n";
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+#include "util.hpp"
+
+namespace GC {
+
+    /*
+
+    objects stored in dicts (keys, values and everything inside of them) live on the heap
+    and are freed by a mark-sweep collector instead of being owned by a namespace.
+
+    roots are the objects owned by namespaces, the objects pinned in them and the stack of the VM.
+    only dicts are traced: pointers don't keep objects alive.
+
+    an object that is known to be unreachable, like the key of a removed dict entry, is freed right away.
+
+    a collection starts when the heap has grown past a threshold: min_heap objects,
+    or growth times the number of objects that survived the previous collection.
+    it may only happen at a poll, where every live object is reachable from the roots.
+
+    */
+    void Register(Object *obj); // puts an object on the heap
+    void Free(Object *obj); // takes an object off the heap and destroys it, nothing may reference it
+    void Mark(Object *obj); // called for roots and for objects reachable from them
+
+    void Poll();
+    void Collect();
+
+    void Configure(uint64_t min_heap, double growth);
+
+    struct Stats {
+        uint64_t collections;
+        uint64_t heap; // objects on the heap
+        uint64_t freed; // objects freed by all collections
+        double total_pause_ms, max_pause_ms;
+    };
+    Stats GetStats();
+    void PrintStats(std::ostream &out);
+}
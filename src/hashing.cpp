@@ -1,5 +1,7 @@
 #include "hashing.hpp"
 
+#include <cstring>
+
 namespace Hashing {
     //https://sair.synerise.com/efficient-integer-pairs-hashing/
     uint64_t SimpleHash(uint64_t x, uint64_t y) {
@@ -18,4 +20,27 @@ namespace Hashing {
     uint64_t Hash(uint64_t x, uint64_t y) {
         return splitmix64(SimpleHash(x, y));
     }
+
+    // the round of xxHash64
+    static uint64_t Round(uint64_t acc, uint64_t word) {
+        acc += word * 0xC2B2AE3D27D4EB4Ful;
+        acc = (acc << 31) | (acc >> 33);
+        return acc * 0x9E3779B185EBCA87ul;
+    }
+    uint64_t HashBytes(uint64_t seed, const char *data, size_t size) {
+        // the size is mixed in first, so zero padding of the last word can't cause collisions
+        uint64_t res = Round(seed, size);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            res = Round(res, word);
+        }
+        if (i < size) {
+            uint64_t word = 0;
+            memcpy(&word, data + i, size - i);
+            res = Round(res, word);
+        }
+        return splitmix64(res);
+    }
 }
\ No newline at end of file
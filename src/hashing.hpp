@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 namespace Hashing {
     uint64_t Hash(uint64_t x, uint64_t y);
+    uint64_t HashBytes(uint64_t seed, const char *data, size_t size); // reads 8 bytes at a time
 }
\ No newline at end of file
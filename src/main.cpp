@@ -1,35 +1,126 @@
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <charconv>
+#include <cmath>
 
 #include "parser.hpp"
 #include "tokenizer.hpp"
 #include "namespaces.hpp"
 #include "predefined.hpp"
 #include "errors.hpp"
+#include "resolver.hpp"
+#include "vm.hpp"
+#include "pool.hpp"
+#include "gc.hpp"
+#include "names.hpp"
+#include "cache.hpp"
+
+static void Run(Node *node) {
+    GC::Poll();
+    Resolver::Resolve(node);
+    // values read out of dicts are pinned until the end of the statement, and a top-level form is one
+    int pins = Namespaces::PinCount(0);
+    if (VM::Enabled()) VM::Execute(node);
+    else {
+        bool do_continue = false, do_break = false, do_return = false;
+        Parser::Execute(node, do_continue, do_break, do_return);
+    }
+    Namespaces::Unpin(0, pins);
+    // functions point into the tree they were created from, so such forms are kept
+    if (!Parser::ContainsFunc(node)) Parser::Destroy(node);
+}
+
+// reads the value of a flag, which must be a number and nothing else
+template <typename T>
+static bool ParseValue(const std::string &text, T &value) {
+    const char *end = text.data() + text.size();
+    auto [stop, error] = std::from_chars(text.data(), end, value);
+    return !text.empty() && error == std::errc() && stop == end;
+}
+static int MalformedValue(const std::string &arg) {
+    std::cerr << "Error: malformed value in " << arg << "\n";
+    return 1;
+}
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
+    const char *file = NULL;
+    bool print_stats = false;
+    bool use_cache = true;
+    bool stream = false;
+    int parse_threads = 1;
+    uint64_t gc_min_heap = 100000;
+    double gc_growth = 2.0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--vm") VM::Enable();
+        else if (arg == "--stats") print_stats = true;
+        else if (arg == "--no-cache") use_cache = false;
+        else if (arg == "--stream") stream = true;
+        else if (arg.rfind("--parse-threads=", 0) == 0) {
+            if (!ParseValue(arg.substr(16), parse_threads)) return MalformedValue(arg);
+        }
+        else if (arg.rfind("--gc-min-heap=", 0) == 0) {
+            if (!ParseValue(arg.substr(14), gc_min_heap)) return MalformedValue(arg);
+        }
+        else if (arg.rfind("--gc-growth=", 0) == 0) {
+            if (!ParseValue(arg.substr(12), gc_growth) || !std::isfinite(gc_growth)) return MalformedValue(arg);
+        }
+        else if (file == NULL) file = argv[i];
+        else {
+            std::cerr << "Error: unexpected argument " << arg << "\n";
+            return 1;
+        }
+    }
+    if (file == NULL) {
         std::cerr << "Error: expected a file\n";
         return 1;
     }
+    if (parse_threads < 1) {
+        std::cerr << "Error: --parse-threads must be at least 1\n";
+        return 1;
+    }
+    if (gc_growth < 1) {
+        std::cerr << "Error: --gc-growth must be at least 1\n";
+        return 1;
+    }
+    GC::Configure(gc_min_heap, gc_growth);
 
 
-    Errors::SetFile(argv[1]);
-    std::fstream fd(argv[1], std::fstream::in);
-    std::vector<Tokenizer::Token> tokens = Tokenizer::Do(fd);
-    //for (auto token: tokens) std::cout << token.id << "(" 
-    //                        << token.begin_in_text << " " << token.end_in_text << ") ";
-    
-    Namespaces::Create(false); // namespace 0;
+    Errors::SetFile(file);
+    Tokenizer::Source source;
+    if (!Tokenizer::Load(file, source)) {
+        std::cerr << "Error: cannot read " << file << "\n";
+        return 1;
+    }
+
+    Namespaces::Create(false, 0); // namespace 0;
     Predefined::Install();
-    
-    int pos = 0; Node *node;
-    while (pos < tokens.size()) {
-        node = Parser::Parse(tokens, pos);
-        bool do_continue = false, do_break = false, do_return = false;
-        Parser::Execute(node, do_continue, do_break, do_return);
+
+    if (stream) {
+        // each form is parsed right before it runs, so only one of them is in memory at a time
+        Tokenizer::Stream forms{&source, 0, 0};
+        std::vector<Tokenizer::Token> tokens;
+        while (Tokenizer::NextForm(forms, tokens)) {
+            int pos = 0;
+            Run(Parser::Parse(tokens, pos));
+        }
+    }
+    else {
+        std::vector<Node*> forms;
+        if (!use_cache || !Cache::Load(file, source, forms)) {
+            forms = Parser::ParseSource(source, parse_threads);
+            if (use_cache) Cache::Store(file, source, forms);
+        }
+        for (Node *node: forms) Run(node);
     }
     
     Namespaces::Destroy();
+    Tokenizer::Unload(source);
+    Names::Destroy();
+    if (print_stats) {
+        Pool::PrintStats(std::cerr);
+        GC::PrintStats(std::cerr);
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -1,21 +1,118 @@
 #include "names.hpp"
 
-#include <string>
-#include <unordered_map>
+#include <vector>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+
+#include "hashing.hpp"
 
 namespace Names {
-    static std::unordered_map<std::string, Name> map;
+    static const uint64_t seed = 0x6e616d6573;
+    static const size_t block_size = 1 << 16;
+
+    // open addressing. the upper half of the hash is kept next to the id,
+    // so a probe only touches the name when it is very likely to match
+    struct Slot {
+        uint32_t id; // id + 1, or 0 when the slot is empty
+        uint32_t tag;
+    };
+
+    static std::vector<std::string_view> names; // indexed by id
+    static std::vector<Slot> slots;
+
+    // lookups share the table, adding a name takes it for itself
+    static std::shared_mutex lock;
+
+    static std::vector<char*> blocks;
+    static char *block_free = NULL;
+    static size_t block_left = 0;
+
+    static const char *Store(std::string_view str) {
+        // long names get a block of their own, so the current one is not wasted
+        if (str.size() > block_size / 4) {
+            char *res = new char[str.size()];
+            blocks.push_back(res);
+            memcpy(res, str.data(), str.size());
+            return res;
+        }
+        if (block_left < str.size()) {
+            block_free = new char[block_size];
+            block_left = block_size;
+            blocks.push_back(block_free);
+        }
+        char *res = block_free;
+        memcpy(res, str.data(), str.size());
+        block_free += str.size();
+        block_left -= str.size();
+        return res;
+    }
 
-    Name GetName(std::string str) {
-        if (map.find(str) != map.end()) return map[str];
-        int sz = map.size();
-        map[str].id = sz;
-        map[str].str = new std::string{str};
-        return map[str];
+    static uint64_t Hash(std::string_view str) {
+        return Hashing::HashBytes(seed, str.data(), str.size());
     }
-    void Destroy() {
-        for (auto [key, val]: map) {
-            delete val.str;
+
+    static void Grow() {
+        std::vector<Slot> grown(slots.empty() ? 1024 : slots.size() * 2, Slot{0, 0});
+        size_t mask = grown.size() - 1;
+        for (size_t id = 0; id < names.size(); id++) {
+            uint64_t hash = Hash(names[id]);
+            size_t i = hash & mask;
+            while (grown[i].id != 0) i = (i + 1) & mask;
+            grown[i] = Slot{uint32_t(id + 1), uint32_t(hash >> 32)};
         }
+        slots.swap(grown);
+    }
+
+    // the slot holding str, or the empty slot where it belongs
+    static size_t Find(std::string_view str, uint64_t hash) {
+        uint32_t tag = hash >> 32;
+        size_t mask = slots.size() - 1, i = hash & mask;
+        for (; slots[i].id != 0; i = (i + 1) & mask) {
+            if (slots[i].tag == tag && names[slots[i].id - 1] == str) break;
+        }
+        return i;
+    }
+
+    Name GetName(std::string_view str) {
+        uint64_t hash = Hash(str);
+        {
+            std::shared_lock<std::shared_mutex> guard(lock);
+            if (!slots.empty()) {
+                size_t i = Find(str, hash);
+                if (slots[i].id != 0) return Name{names[slots[i].id - 1], slots[i].id - 1};
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> guard(lock);
+        if (slots.empty()) Grow();
+        // another thread may have added it in between
+        size_t i = Find(str, hash);
+        if (slots[i].id != 0) return Name{names[slots[i].id - 1], slots[i].id - 1};
+
+        uint32_t id = names.size();
+        uint32_t tag = hash >> 32;
+        names.push_back(std::string_view(Store(str), str.size()));
+        slots[i] = Slot{id + 1, tag};
+        // at most half of the slots are used, so probe sequences stay short
+        if (2 * names.size() > slots.size()) Grow();
+        return Name{names[id], id};
+    }
+    std::string_view GetString(uint64_t id) {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        return names[id];
+    }
+    size_t Count() {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        return names.size();
+    }
+    void Destroy() {
+        std::unique_lock<std::shared_mutex> guard(lock);
+        for (char *block: blocks) delete[] block;
+        blocks.clear();
+        block_free = NULL;
+        block_left = 0;
+        names.clear();
+        slots.clear();
     }
-}
\ No newline at end of file
+}
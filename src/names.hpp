@@ -1,22 +1,24 @@
 #pragma once
 
 #include <cstdint>
-#include <string>
+#include <string_view>
 
 namespace Names {
     struct Name {
-        std::string *str; 
+        std::string_view str; // stays valid until Destroy
         uint64_t id;
-    };  
+    };
 
 
-    Name GetName(std::string str);
+    Name GetName(std::string_view str);
+    std::string_view GetString(uint64_t id);
+    size_t Count();
     void Destroy();
 
     /*
     
-    all string values are stored internally in a hash map
-    when a new name is found, it gets assigned an integer identifier
+    all names are stored internally in a hash table, and their characters in an arena
+    when a new name is found, it gets assigned the next integer identifier
 
     */
-}
\ No newline at end of file
+}
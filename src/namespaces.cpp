@@ -1,63 +1,93 @@
 #include "namespaces.hpp"
 
-#include <unordered_map>
-#include <unordered_set>
 #include <iostream>
 #include <vector>
 
 #include "objects.hpp"
 #include "errors.hpp"
-
-// todo: garbage collection
+#include "gc.hpp"
 
 namespace Namespaces {
     struct Namespace {
         bool can_access_parent;
+        int frame; // namespace whose stack holds the arguments
 
-        std::unordered_map<uint64_t, Object*> map;
+        std::vector<Object*> slots;
         std::vector<Object*> stack;
-        std::unordered_set<Object*> tracked;
+        std::vector<Object*> region; // objects owned by the namespace
+        std::vector<Object*> pins;
     };
 
+    /*
+
+    namespaces are never freed, only reset. a namespace created at the same depth as a destroyed one
+    reuses its memory, so loops which create a namespace on every iteration don't allocate anything for it.
+
+    */
     static std::vector<Namespace> vec;
+    static int count = 0;
 
     static void Check(int namespace_id) {
-        if (!(0 <= namespace_id && namespace_id < vec.size())) RuntimeError("Invalid namespace id");
+        if (!(0 <= namespace_id && namespace_id < count)) RuntimeError("Invalid namespace id");
     }
 
-    int Create(bool can_access_parent) {
-        vec.push_back({can_access_parent, {}, {}, {}});
-        if (can_access_parent && vec.size() >= 2) {
-            for (auto arg: vec[vec.size() - 2].stack) {
+    int Create(bool can_access_parent, int slots, bool copies_args) {
+        if (count == vec.size()) vec.emplace_back();
+        Namespace &ns = vec[count++];
+        ns.can_access_parent = can_access_parent;
+        ns.frame = count - 1;
+        ns.slots.assign(slots, NULL);
+        if (can_access_parent && count >= 2) {
+            int frame = vec[count - 2].frame;
+            if (!copies_args) {
+                ns.frame = frame;
+                return count - 1;
+            }
+            for (auto arg: vec[frame].stack) {
                 arg = Objects::Copy(arg, true);
-                Track(vec.size() - 1, arg);
-                PushOnStack(vec.size() - 1, arg);
+                Track(count - 1, arg);
+                ns.stack.push_back(arg);
             }
         }
-        return vec.size() - 1;
+        return count - 1;
     }
     void Destroy() {
-        int cur = Current();
-        for (auto obj: vec[cur].tracked) {
+        Namespace &ns = vec[Current()];
+        for (auto obj: ns.region) {
             Objects::Destroy(obj);
         }
-        vec.pop_back();
+        ns.region.clear();
+        ns.pins.clear();
+        ns.slots.clear();
+        ns.stack.clear();
+        count--;
     }
 
     int Current() {
-        if (vec.empty()) RuntimeError("No current namespace");
-        return vec.size() - 1;
+        if (count == 0) RuntimeError("No current namespace");
+        return count - 1;
     }
     int Parent() {
-        if (vec.size() < 2) RuntimeError("No parent namespace");
-        return vec.size() - 2;
+        if (count < 2) RuntimeError("No parent namespace");
+        return count - 2;
     }
 
     void PushOnStack(int namespace_id, Object *obj) {
         Check(namespace_id);
         
         vec[namespace_id].stack.push_back(obj);
-        vec[namespace_id].tracked.insert(obj);
+    }
+    bool PushArg(Object *obj) {
+        if (obj != NULL && !Objects::IsReferenceable(obj) && Untrack(Parent(), obj)) {
+            Objects::MakeReferenceable(obj);
+            Track(Current(), obj);
+            vec[Current()].stack.push_back(obj);
+            return false;
+        }
+        Object *copy = Objects::Copy(obj, true);
+        Track(Current(), copy);
+        vec[Current()].stack.push_back(copy);
+        return true;
     }
     void PopFromStack(int namespace_id) {
         Check(namespace_id);
@@ -69,80 +99,92 @@ namespace Namespaces {
     Object *AccessStack(int namespace_id, int pos) {
         Check(namespace_id);
 
-        if (!(0 <= pos && pos < vec[namespace_id].stack.size()))
+        std::vector<Object*> &stack = vec[vec[namespace_id].frame].stack;
+        if (!(0 <= pos && pos < stack.size()))
             RuntimeError("Stack access pos out of range");
         
-        return vec[namespace_id].stack[vec[namespace_id].stack.size() - pos - 1];
+        return stack[stack.size() - pos - 1];
     }
     int StackSize(int namespace_id) {
         Check(namespace_id);
 
-        return vec[namespace_id].stack.size();
+        return vec[vec[namespace_id].frame].stack.size();
     }
 
     void Track(int namespace_id, Object *obj) {
         if (obj == NULL) return;
         Check(namespace_id);
 
-        vec[namespace_id].tracked.insert(obj);
+        vec[namespace_id].region.push_back(obj);
     }
-    void Untrack(int namespace_id, Object *obj) {
-        if (obj == NULL) return;
+    bool Untrack(int namespace_id, Object *obj) {
+        if (obj == NULL) return false;
         Check(namespace_id);
 
-        vec[namespace_id].tracked.erase(obj);
+        // temporaries are usually untracked soon after they are created, so the search starts from the end
+        std::vector<Object*> &region = vec[namespace_id].region;
+        for (int i = (int)region.size() - 1; i >= 0; i--) {
+            if (region[i] == obj) {
+                region[i] = region.back();
+                region.pop_back();
+                return true;
+            }
+        }
+        return false;
     }
-    void Add(int namespace_id, Names::Name name, Object *obj) {
-        if (obj == NULL) return;
+    Object *Promote(int namespace_id, Object *obj) {
+        if (obj == NULL) return NULL;
         Check(namespace_id);
 
-        vec[namespace_id].tracked.insert(obj);
-        vec[namespace_id].map[name.id] = obj;
+        if (!Objects::IsReferenceable(obj) && Untrack(Current(), obj)) {
+            vec[namespace_id].region.push_back(obj);
+            return obj;
+        }
+        Object *res = Objects::Copy(obj, false);
+        Track(namespace_id, res);
+        return res;
     }
-    bool Present(int namespace_id, Names::Name name) {
+    void Add(int namespace_id, int slot, Object *obj) {
+        if (obj == NULL) return;
         Check(namespace_id);
 
-        while (namespace_id >= 0) {
-            if (vec[namespace_id].map.find(name.id) != vec[namespace_id].map.end()) {
-                return true;
-            }
-
-            if (vec[namespace_id].can_access_parent) {
-                namespace_id--;
-            }
-            else break;
-        }
+        if (slot >= vec[namespace_id].slots.size()) vec[namespace_id].slots.resize(slot + 1, NULL);
+        vec[namespace_id].slots[slot] = obj;
+    }
+    Object *Find(int namespace_id, const std::vector<Address> &addresses) {
+        Check(namespace_id);
 
-        if (namespace_id != 0) {
-            namespace_id = 0;
-            if (vec[namespace_id].map.find(name.id) != vec[namespace_id].map.end()) {
-                return true;
+        for (auto address: addresses) {
+            Namespace &ns = vec[address.depth < 0 ? 0 : namespace_id - address.depth];
+            if (address.slot < ns.slots.size() && ns.slots[address.slot] != NULL) {
+                return ns.slots[address.slot];
             }
         }
-        return false;
+        return NULL;
     }
-    Object *Find(int namespace_id, Names::Name name) {
+
+    void Pin(int namespace_id, Object *obj) {
+        if (obj == NULL) return;
         Check(namespace_id);
 
-        while (namespace_id >= 0) {
-            if (vec[namespace_id].map.find(name.id) != vec[namespace_id].map.end()) {
-                return vec[namespace_id].map[name.id];
-            }
+        vec[namespace_id].pins.push_back(obj);
+    }
+    int PinCount(int namespace_id) {
+        Check(namespace_id);
 
-            if (vec[namespace_id].can_access_parent) {
-                namespace_id--;
-            }
-            else break;
-        }
+        return vec[namespace_id].pins.size();
+    }
+    void Unpin(int namespace_id, int count) {
+        Check(namespace_id);
 
-        if (namespace_id != 0) {
-            namespace_id = 0;
-            if (vec[namespace_id].map.find(name.id) != vec[namespace_id].map.end()) {
-                return vec[namespace_id].map[name.id];
-            }
+        if (count < vec[namespace_id].pins.size()) vec[namespace_id].pins.resize(count);
+    }
+    void MarkRoots() {
+        for (int i = 0; i < count; i++) {
+            for (auto obj: vec[i].slots) GC::Mark(obj);
+            for (auto obj: vec[i].stack) GC::Mark(obj);
+            for (auto obj: vec[i].region) GC::Mark(obj);
+            for (auto obj: vec[i].pins) GC::Mark(obj);
         }
-
-        RuntimeError("Couldn't find object by name");
-        return NULL;
     }
 }
\ No newline at end of file
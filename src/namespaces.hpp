@@ -3,6 +3,8 @@
 #include "objects.hpp"
 #include "names.hpp"
 
+#include <vector>
+
 namespace Namespaces {
 
     /*
@@ -11,25 +13,50 @@ namespace Namespaces {
     some namespaces can access their parrent namespace.
 
     when functions are called, arguments are pushed on stack of the recently created namespace.
+    a namespace which can access its parent reads the arguments from the stack of the parent,
+    unless it may modify them: then it gets copies of its own.
 
     any object that is created has to be added to a namespace. this way it can be tracked.
-    when namespace is destroyed, it destroys all of the objects it is currently tracking
+    when namespace is destroyed, it destroys all of the objects it is currently tracking.
+    tracked objects are kept in a region of the namespace, an object must be tracked only once.
+    a temporary that outlives its namespace is promoted: it is moved to the region of another namespace.
+
+    names are resolved before execution (see Resolver), so a namespace stores its objects
+    in an array of slots. namespace 0 holds global objects and its slots are indexed by name ids.
 
     */
-    int Create(bool can_access_parent);
+    struct Address {
+        int depth; // how many namespaces below the current one, or -1 for namespace 0
+        int slot;
+    };
+
+    int Create(bool can_access_parent, int slots, bool copies_args = false);
     void Destroy(); // destroys the topmost namespace
 
     int Current();
     int Parent();
 
     void PushOnStack(int namespace_id, Object *obj);
+    // pushes an argument on the stack of the current namespace: a temporary of the parent namespace is moved,
+    // anything else is copied. returns false if obj was moved, then the caller must not destroy it
+    bool PushArg(Object *obj);
     void PopFromStack(int namespace_id);
     Object *AccessStack(int namespace_id, int pos);
     int StackSize(int namespace_id);
 
     void Track(int namespace_id, Object *obj);
-    void Untrack(int namespace_id, Object *obj);
-    void Add(int namespace_id, Names::Name name, Object *obj);
-    bool Present(int namespace_id, Names::Name name);
-    Object *Find(int namespace_id, Names::Name name);
+    bool Untrack(int namespace_id, Object *obj); // returns false if the object wasn't tracked there
+    // moves obj from the current namespace to the given one if it is a temporary,
+    // otherwise tracks a temporary copy of it there
+    Object *Promote(int namespace_id, Object *obj);
+    void Add(int namespace_id, int slot, Object *obj); // binds obj to a slot, it has to be tracked separately
+
+    // a pinned object is kept alive by GC while the namespace exists, even if it isn't owned by it.
+    // pins made after the given count can be dropped
+    void Pin(int namespace_id, Object *obj);
+    int PinCount(int namespace_id);
+    void Unpin(int namespace_id, int count);
+    void MarkRoots(); // marks every object owned or pinned by a namespace
+    // returns the object at the first occupied address, or NULL if there is none
+    Object *Find(int namespace_id, const std::vector<Address> &addresses);
 }
\ No newline at end of file
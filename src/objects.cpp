@@ -2,22 +2,41 @@
 #include "errors.hpp"
 #include "parser.hpp"
 #include "hashing.hpp"
+#include "pool.hpp"
 
 #include <cmath>
 #include <iostream>
+#include <string_view>
+
+// string payloads are shared between copies and cloned when one of them is modified.
+// the string is value[start...], so prefixes are removed and added without moving the rest of it.
+// the unused space is dropped (the string is flattened) when the value is needed as a whole.
+// a substring may be a view: then it is the part [start, start + length) of its parent, and value is unused
+struct StringBuffer {
+    int refs;
+    bool has_hash; // hash is cached until the value is modified
+    uint64_t hash;
+    size_t start;
+    STRING_T value;
+    StringBuffer *parent; // never a view itself
+    size_t length;
+};
 
 struct Object {
     Objects::Type type;
-    union {
-        BOOL_T *_bool;
-        CHAR_T *_char;
-        INT_T *_int;
-        REAL_T *_real;
-        STRING_T *_string;
-        PTR_T *_ptr;
+    uint32_t gc_epoch; // last collection that has marked the object
+    union { // scalars are stored inline, other types are stored on the heap
+        BOOL_T _bool;
+        CHAR_T _char;
+        INT_T _int;
+        REAL_T _real;
+        PTR_T _ptr;
+        StringBuffer *_string;
         DICT_T *_dict;
         FUNC_T *_func;
+        ARRAY_T *_array;
     };
+    uint32_t heap_pos; // position on the GC heap, if the object is there
     bool is_referenceable;
 };
 
@@ -35,103 +54,154 @@ namespace Objects {
         return obj->type;
     }
     BOOL_T *GetBool(Object *obj) {
-        return obj->_bool;
+        return &obj->_bool;
     }
     CHAR_T *GetChar(Object *obj) {
-        return obj->_char;
+        return &obj->_char;
     }
     INT_T *GetInt(Object *obj) {
-        return obj->_int;
+        return &obj->_int;
     }
     REAL_T *GetReal(Object *obj) {
-        return obj->_real;
-    }
-    STRING_T *GetString(Object *obj) {
+        return &obj->_real;
+    }
+    static std::string_view View(StringBuffer *str) {
+        if (str->parent != NULL) return View(str->parent).substr(str->start, str->length);
+        return std::string_view(str->value).substr(str->start);
+    }
+    static void Release(StringBuffer *str) {
+        if (--str->refs > 0) return;
+        if (str->parent != NULL) Release(str->parent);
+        Pool::Delete(str);
+    }
+    // a view gets its own copy of the characters, other strings drop the space before them
+    static void Flatten(StringBuffer *str) {
+        if (str->parent != NULL) {
+            str->value = View(str);
+            Release(str->parent);
+            str->parent = NULL;
+            str->start = 0;
+            return;
+        }
+        if (str->start == 0) return;
+        str->value.erase(0, str->start);
+        str->start = 0;
+    }
+    // clones the payload if it is shared, the value is going to be modified
+    static StringBuffer *Unshare(Object *obj) {
+        if (obj->_string->refs > 1) {
+            obj->_string->refs--;
+            StringBuffer *copy = Pool::New<StringBuffer>();
+            copy->refs = 1;
+            copy->value = View(obj->_string);
+            obj->_string = copy;
+        }
+        if (obj->_string->parent != NULL) Flatten(obj->_string);
+        obj->_string->has_hash = false;
         return obj->_string;
     }
+
+    const STRING_T *GetString(Object *obj) {
+        Flatten(obj->_string);
+        return &obj->_string->value;
+    }
+    STRING_T *GetMutableString(Object *obj) {
+        StringBuffer *str = Unshare(obj);
+        Flatten(str);
+        return &str->value;
+    }
     PTR_T *GetPtr(Object *obj) {
-        return obj->_ptr;
+        return &obj->_ptr;
     }
     DICT_T *GetDict(Object *obj) {
         return obj->_dict;
     }
+    ARRAY_T *GetArray(Object *obj) {
+        return obj->_array;
+    }
+    ARRAY_T *GetMutableArray(Object *obj) {
+        obj->_array = CustomTypes::ArrayUnshare(obj->_array);
+        return obj->_array;
+    }
     FUNC_T *GetFunc(Object *obj) {
         return obj->_func;
     }
     bool IsReferenceable(Object *obj) {
         return obj->is_referenceable;
     }
+    bool Mark(Object *obj, uint32_t epoch) {
+        if (obj->gc_epoch == epoch) return false;
+        obj->gc_epoch = epoch;
+        return true;
+    }
+    bool IsMarked(Object *obj, uint32_t epoch) {
+        return obj->gc_epoch == epoch;
+    }
+    uint32_t &HeapPos(Object *obj) {
+        return obj->heap_pos;
+    }
 
 
     Object *Create(Type type) {
-        Object *res = new Object;
+        Object *res = Pool::New<Object>();
         res->type = type;
         switch (type) {
-            case BOOL: res->_bool = new BOOL_T; break;
-            case CHAR: res->_char = new CHAR_T; break;
-            case INT: res->_int = new INT_T; break;
-            case REAL: res->_real = new REAL_T; break;
-            case STRING: res->_string = new STRING_T; break;
-            case POINTER: res->_ptr = new PTR_T; break;
+            case BOOL: case CHAR: case INT: case REAL: case POINTER: res->_int = 0; break;
+            case STRING: res->_string = Pool::New<StringBuffer>(); res->_string->refs = 1; break;
             case DICT: res->_dict = CustomTypes::DictCreate(); break;
             case FUNCTION: res->_func = CustomTypes::FuncCreate(); break;
+            case ARRAY: res->_array = CustomTypes::ArrayCreate(false, 0); break;
         }
         res->is_referenceable = false;
         return res;
     }
-    void Destroy(Object *obj) {
-        CheckNULL(obj);
+    static void DestroyPayload(Object *obj) {
         switch (obj->type) {
-            case BOOL: delete obj->_bool; break;
-            case CHAR: delete obj->_char; break;
-            case INT: delete obj->_int; break;
-            case REAL: delete obj->_real; break;
-            case STRING: delete obj->_string; break;
-            case POINTER: delete obj->_ptr; break;
+            case STRING: Release(obj->_string); break;
             case DICT: CustomTypes::DictDestroy(obj->_dict); break;
             case FUNCTION: CustomTypes::FuncDestroy(obj->_func); break;
+            case ARRAY: CustomTypes::ArrayDestroy(obj->_array); break;
         }
-        delete obj;
     }
-    Object *Copy(Object *obj, bool make_referenceable) {
-        if (obj == NULL) return NULL;
-
-        Object *res = new Object;
+    static void CopyPayload(Object *res, Object *obj) {
         res->type = obj->type;
-        res->is_referenceable = make_referenceable;
-
-        switch (res->type) {
-            case BOOL: res->_bool = new BOOL_T{*obj->_bool}; break;
-            case CHAR: res->_char = new CHAR_T{*obj->_char}; break;
-            case INT: res->_int = new INT_T{*obj->_int}; break;
-            case REAL: res->_real = new REAL_T{*obj->_real}; break;
-            case STRING: res->_string = new STRING_T{*obj->_string}; break;
-            case POINTER: res->_ptr = new PTR_T{*obj->_ptr}; break;
+        switch (obj->type) {
+            case BOOL: res->_bool = obj->_bool; break;
+            case CHAR: res->_char = obj->_char; break;
+            case INT: res->_int = obj->_int; break;
+            case REAL: res->_real = obj->_real; break;
+            case STRING: res->_string = obj->_string; res->_string->refs++; break;
+            case POINTER: res->_ptr = obj->_ptr; break;
             case DICT: res->_dict = CustomTypes::DictCopy(obj->_dict); break;
             case FUNCTION: res->_func = CustomTypes::FuncCopy(obj->_func); break;
+            case ARRAY: res->_array = CustomTypes::ArrayCopy(obj->_array); break;
         }
+    }
 
+    void Destroy(Object *obj) {
+        CheckNULL(obj);
+        DestroyPayload(obj);
+        Pool::Delete(obj);
+    }
+    Object *Copy(Object *obj, bool make_referenceable) {
+        if (obj == NULL) return NULL;
+
+        Object *res = Pool::New<Object>();
+        CopyPayload(res, obj);
+        res->is_referenceable = make_referenceable;
         return res;
     }
     void ReplaceWithCopy(Object *first, Object *second, bool make_referenceable) {
         CheckNULL(first);
         CheckNULL(second);
 
-        switch (first->type) {
-            case BOOL: delete first->_bool; break;
-            case CHAR: delete first->_char; break;
-            case INT: delete first->_int; break;
-            case REAL: delete first->_real; break;
-            case STRING: delete first->_string; break;
-            case POINTER: delete first->_ptr; break;
-            case DICT: CustomTypes::DictDestroy(first->_dict); break;
-            case FUNCTION: CustomTypes::FuncDestroy(first->_func); break;
-        }
-
-        Object *copy = Copy(second, make_referenceable);
-        *first = *copy;
-        first->is_referenceable = true;
-        delete copy;
+        // second may be owned by first, so first is only written once the copy is complete
+        // and the old payload is destroyed after that
+        Object copy = *first, old = *first;
+        CopyPayload(&copy, second);
+        copy.is_referenceable = true;
+        *first = copy;
+        DestroyPayload(&old);
     }
     void MakeReferenceable(Object *first) {
         CheckNULL(first);
@@ -148,14 +218,15 @@ namespace Objects {
         Object *res = Create(BOOL);
         res->is_referenceable = false;
         switch (first->type) {
-            case BOOL: *res->_bool = *first->_bool; break;
-            case CHAR: *res->_bool = *first->_char != 0; break;
-            case INT: *res->_bool = *first->_int != 0; break;
-            case REAL: *res->_bool = *first->_real != 0; break;
-            case STRING: *res->_bool = !first->_string->empty(); break;
-            case POINTER: *res->_bool = *first->_ptr != NULL; break;
-            case DICT: *res->_bool = CustomTypes::DictSize(first->_dict) != 0; break;
-            case FUNCTION: *res->_bool = true; break;
+            case BOOL: res->_bool = first->_bool; break;
+            case CHAR: res->_bool = first->_char != 0; break;
+            case INT: res->_bool = first->_int != 0; break;
+            case REAL: res->_bool = first->_real != 0; break;
+            case STRING: res->_bool = !View(first->_string).empty(); break;
+            case POINTER: res->_bool = first->_ptr != NULL; break;
+            case DICT: res->_bool = CustomTypes::DictSize(first->_dict) != 0; break;
+            case FUNCTION: res->_bool = true; break;
+            case ARRAY: res->_bool = CustomTypes::ArraySize(first->_array) != 0; break;
         }
         return res;
     }
@@ -165,9 +236,9 @@ namespace Objects {
         Object *res = Create(CHAR);
         res->is_referenceable = false;
         switch (first->type) {
-            case BOOL: *res->_char = *first->_bool; break;
-            case CHAR: *res->_char = *first->_char; break;
-            case INT: *res->_char = *first->_int; break;
+            case BOOL: res->_char = first->_bool; break;
+            case CHAR: res->_char = first->_char; break;
+            case INT: res->_char = first->_int; break;
         }
         return res;
     }
@@ -177,13 +248,13 @@ namespace Objects {
         Object *res = Create(INT);
         res->is_referenceable = false;
         switch (first->type) {
-            case BOOL: *res->_int = *first->_bool; break;
-            case CHAR: *res->_int = *first->_char; break;
-            case INT: *res->_int = *first->_int; break;
-            case REAL: *res->_int = *first->_real; break;
+            case BOOL: res->_int = first->_bool; break;
+            case CHAR: res->_int = first->_char; break;
+            case INT: res->_int = first->_int; break;
+            case REAL: res->_int = first->_real; break;
             case STRING: {
                 try {
-                    *res->_int = std::stoll(*first->_string); break;
+                    res->_int = std::stoll(*GetString(first)); break;
                 } catch (...) {
                     RuntimeError("Conversion to int has failed");
                 }
@@ -197,13 +268,13 @@ namespace Objects {
         Object *res = Create(REAL);
         res->is_referenceable = false;
         switch (first->type) {
-            case BOOL: *res->_real = *first->_bool; break;
-            case CHAR: *res->_real = *first->_char; break;
-            case INT: *res->_real = *first->_int; break;
-            case REAL: *res->_real = *first->_real; break;
+            case BOOL: res->_real = first->_bool; break;
+            case CHAR: res->_real = first->_char; break;
+            case INT: res->_real = first->_int; break;
+            case REAL: res->_real = first->_real; break;
             case STRING: {
                 try {
-                    *res->_real = std::stod(*first->_string); break;
+                    res->_real = std::stod(*GetString(first)); break;
                 } catch (...) {
                     RuntimeError("Conversion to real has failed");
                 }
@@ -213,46 +284,38 @@ namespace Objects {
     }
     Object *CastToString(Object *first) {
         CheckNULL(first);
+        if (first->type == STRING) return Copy(first, false);
         Object *res = Create(STRING);
         res->is_referenceable = false;
-        switch (first->type) {
-            case BOOL: *res->_string = (*first->_bool?"true":"false"); break;
-            case CHAR: *res->_string = std::string{*first->_char}; break;
-            case INT: *res->_string = std::to_string(*first->_int); break;
-            case REAL: *res->_string = std::to_string(*first->_real); break;
-            case STRING: *res->_string = *first->_string; break;
-            case POINTER: *res->_string = std::to_string((uint64_t)*first->_ptr); break;
-            case DICT: *res->_string = CustomTypes::DictString(first->_dict); break;
-            case FUNCTION: *res->_string = "function"; break;
-        }
+        res->_string->value = AsString(first);
         return res;
     }
     Object *Deref(Object *first) {
         CheckNULL(first);
         CheckType(first, POINTER);
 
-        if (*first->_ptr == NULL) RuntimeError("Deref of NULL pointer");
-        return (Object*)*first->_ptr;
+        if (first->_ptr == NULL) RuntimeError("Deref of NULL pointer");
+        return (Object*)first->_ptr;
     }
     Object *Ref(Object *first) {
         CheckNULL(first);
 
         Object *res = Create(POINTER);
-        *res->_ptr = (PTR_T)first;
+        res->_ptr = (PTR_T)first;
         return res;
     }
     Object *CalcInv(Object *first) {
         CheckNULL(first);
         CheckType(first, INT);
         Object *res = Create(INT);
-        *res->_int = ~*first->_int;
+        res->_int = ~first->_int;
         return res;
     }
     Object *CalcNot(Object *first) {
         CheckNULL(first);
         CheckType(first, BOOL);
         Object *res = Create(BOOL);
-        *res->_bool = !*first->_bool;
+        res->_bool = !first->_bool;
         return res;
     }
     Object *CalcNeg(Object *first) {
@@ -261,11 +324,11 @@ namespace Objects {
         Object *res;
         if (first->type == INT) {
             res = Create(INT);
-            *res->_int = -*first->_int;
+            res->_int = -first->_int;
         }
         else {
             res = Create(REAL);
-            *res->_real = -*first->_real;
+            res->_real = -first->_real;
         }
         return res;
     }
@@ -277,19 +340,19 @@ namespace Objects {
         Object *res;
         if (first->type == INT && second->type == INT) {
             res = Create(INT);
-            *res->_int = *first->_int * *second->_int;
+            res->_int = first->_int * second->_int;
         }
         else if (first->type == INT && second->type == REAL) {
             res = Create(REAL);
-            *res->_real = *first->_int * *second->_real;
+            res->_real = first->_int * second->_real;
         }
         else if (first->type == REAL && second->type == INT) {
             res = Create(REAL);
-            *res->_real = *first->_real * *second->_int;
+            res->_real = first->_real * second->_int;
         }
         else {
             res = Create(REAL);
-            *res->_real = *first->_real * *second->_real;
+            res->_real = first->_real * second->_real;
         }
         return res;
     }
@@ -301,19 +364,19 @@ namespace Objects {
         Object *res;
         if (first->type == INT && second->type == INT) {
             res = Create(INT);
-            *res->_int = *first->_int / *second->_int;
+            res->_int = first->_int / second->_int;
         }
         else if (first->type == INT && second->type == REAL) {
             res = Create(REAL);
-            *res->_real = *first->_int / *second->_real;
+            res->_real = first->_int / second->_real;
         }
         else if (first->type == REAL && second->type == INT) {
             res = Create(REAL);
-            *res->_real = *first->_real / *second->_int;
+            res->_real = first->_real / second->_int;
         }
         else {
             res = Create(REAL);
-            *res->_real = *first->_real / *second->_real;
+            res->_real = first->_real / second->_real;
         }
         return res;
     }
@@ -325,19 +388,19 @@ namespace Objects {
         Object *res;
         if (first->type == INT && second->type == INT) {
             res = Create(INT);
-            *res->_int = *first->_int % *second->_int;
+            res->_int = first->_int % second->_int;
         }
         else if (first->type == INT && second->type == REAL) {
             res = Create(REAL);
-            *res->_real = std::remainder(*first->_int, *second->_real);
+            res->_real = std::remainder(first->_int, second->_real);
         }
         else if (first->type == REAL && second->type == INT) {
             res = Create(REAL);
-            *res->_real = std::remainder(*first->_real, *second->_int);
+            res->_real = std::remainder(first->_real, second->_int);
         }
         else {
             res = Create(REAL);
-            *res->_real = std::remainder(*first->_real, *second->_real);
+            res->_real = std::remainder(first->_real, second->_real);
         }
         return res;
     }
@@ -349,19 +412,19 @@ namespace Objects {
         Object *res;
         if (first->type == INT && second->type == INT) {
             res = Create(INT);
-            *res->_int = *first->_int + *second->_int;
+            res->_int = first->_int + second->_int;
         }
         else if (first->type == INT && second->type == REAL) {
             res = Create(REAL);
-            *res->_real = *first->_int + *second->_real;
+            res->_real = first->_int + second->_real;
         }
         else if (first->type == REAL && second->type == INT) {
             res = Create(REAL);
-            *res->_real = *first->_real + *second->_int;
+            res->_real = first->_real + second->_int;
         }
         else {
             res = Create(REAL);
-            *res->_real = *first->_real + *second->_real;
+            res->_real = first->_real + second->_real;
         }
         return res;
     }
@@ -373,19 +436,19 @@ namespace Objects {
         Object *res;
         if (first->type == INT && second->type == INT) {
             res = Create(INT);
-            *res->_int = *first->_int - *second->_int;
+            res->_int = first->_int - second->_int;
         }
         else if (first->type == INT && second->type == REAL) {
             res = Create(REAL);
-            *res->_real = *first->_int - *second->_real;
+            res->_real = first->_int - second->_real;
         }
         else if (first->type == REAL && second->type == INT) {
             res = Create(REAL);
-            *res->_real = *first->_real - *second->_int;
+            res->_real = first->_real - second->_int;
         }
         else {
             res = Create(REAL);
-            *res->_real = *first->_real - *second->_real;
+            res->_real = first->_real - second->_real;
         }
         return res;
     }
@@ -395,7 +458,7 @@ namespace Objects {
         CheckType(first, INT);
         CheckType(second, INT);
         Object *res = Create(INT);
-        *res->_int = *first->_int << *second->_int;
+        res->_int = first->_int << second->_int;
         return res;
     }
     Object *CalcShr(Object *first, Object *second) {
@@ -404,7 +467,7 @@ namespace Objects {
         CheckType(first, INT);
         CheckType(second, INT);
         Object *res = Create(INT);
-        *res->_int = *first->_int >> *second->_int;
+        res->_int = first->_int >> second->_int;
         return res;
     }
     Object *CalcLt(Object *first, Object *second) {
@@ -414,16 +477,16 @@ namespace Objects {
         CheckType(second, INT | REAL);
         Object *res = Create(BOOL);
         if (first->type == INT && second->type == INT) {
-            *res->_bool = *first->_int < *second->_int;
+            res->_bool = first->_int < second->_int;
         }
         else if (first->type == INT && second->type == REAL) {
-            *res->_bool = *first->_int < *second->_real;
+            res->_bool = first->_int < second->_real;
         }
         else if (first->type == REAL && second->type == INT) {
-            *res->_bool = *first->_real < *second->_int;
+            res->_bool = first->_real < second->_int;
         }
         else {
-            *res->_bool = *first->_real < *second->_real;
+            res->_bool = first->_real < second->_real;
         }
         return res;
     }
@@ -437,16 +500,16 @@ namespace Objects {
         CheckType(second, INT | REAL);
         Object *res = Create(BOOL);
         if (first->type == INT && second->type == INT) {
-            *res->_bool = *first->_int <= *second->_int;
+            res->_bool = first->_int <= second->_int;
         }
         else if (first->type == INT && second->type == REAL) {
-            *res->_bool = *first->_int <= *second->_real;
+            res->_bool = first->_int <= second->_real;
         }
         else if (first->type == REAL && second->type == INT) {
-            *res->_bool = *first->_real <= *second->_int;
+            res->_bool = first->_real <= second->_int;
         }
         else {
-            *res->_bool = *first->_real <= *second->_real;
+            res->_bool = first->_real <= second->_real;
         }
         return res;
     }
@@ -458,24 +521,25 @@ namespace Objects {
         CheckNULL(second);
         Object *res = Create(BOOL);
         if (first->type != second->type) {
-            *res->_bool = false;
+            res->_bool = false;
             return res;
         }
         switch (first->type) {
-            case BOOL: *res->_bool = *first->_bool == *second->_bool; break;
-            case CHAR: *res->_bool = *first->_char == *second->_char; break;
-            case INT: *res->_bool = *first->_int == *second->_int; break;
-            case REAL: *res->_bool = *first->_real == *second->_real; break;
-            case STRING: *res->_bool = *first->_string == *second->_string; break;
-            case POINTER: *res->_bool = *first->_ptr == *second->_ptr; break;
-            case DICT: *res->_bool = CustomTypes::DictEqual(first->_dict, second->_dict); break;
-            case FUNCTION: *res->_bool = CustomTypes::FuncEqual(first->_func, second->_func); break;
+            case BOOL: res->_bool = first->_bool == second->_bool; break;
+            case CHAR: res->_bool = first->_char == second->_char; break;
+            case INT: res->_bool = first->_int == second->_int; break;
+            case REAL: res->_bool = first->_real == second->_real; break;
+            case STRING: res->_bool = Equal(first, second); break;
+            case POINTER: res->_bool = first->_ptr == second->_ptr; break;
+            case DICT: res->_bool = CustomTypes::DictEqual(first->_dict, second->_dict); break;
+            case FUNCTION: res->_bool = CustomTypes::FuncEqual(first->_func, second->_func); break;
+            case ARRAY: res->_bool = CustomTypes::ArrayEqual(first->_array, second->_array); break;
         }
         return res;
     }
     Object *CalcNeq(Object *first, Object *second) {
         Object *res = CalcEq(first, second);
-        *res->_bool = !*res->_bool;
+        res->_bool = !res->_bool;
         return res;
     }
     Object *CalcAnd(Object *first, Object *second) {
@@ -484,7 +548,7 @@ namespace Objects {
         CheckType(first, INT);
         CheckType(second, INT);
         Object *res = Create(INT);
-        *res->_int = *first->_int & *second->_int;
+        res->_int = first->_int & second->_int;
         return res;
     }
     Object *CalcXor(Object *first, Object *second) {
@@ -493,7 +557,7 @@ namespace Objects {
         CheckType(first, INT);
         CheckType(second, INT);
         Object *res = Create(INT);
-        *res->_int = *first->_int ^ *second->_int;
+        res->_int = first->_int ^ second->_int;
         return res;
     }
     Object *CalcOr(Object *first, Object *second) {
@@ -502,7 +566,7 @@ namespace Objects {
         CheckType(first, INT);
         CheckType(second, INT);
         Object *res = Create(INT);
-        *res->_int = *first->_int | *second->_int;
+        res->_int = first->_int | second->_int;
         return res;
     }
     Object *CalcConj(Object *first, Object *second) {
@@ -511,7 +575,7 @@ namespace Objects {
         CheckType(first, BOOL);
         CheckType(second, BOOL);
         Object *res = Create(BOOL);
-        *res->_bool = *first->_bool && *second->_bool;
+        res->_bool = first->_bool && second->_bool;
         return res;
     }
     Object *CalcDisj(Object *first, Object *second) {
@@ -520,7 +584,7 @@ namespace Objects {
         CheckType(first, BOOL);
         CheckType(second, BOOL);
         Object *res = Create(BOOL);
-        *res->_bool = *first->_bool || *second->_bool;
+        res->_bool = first->_bool || second->_bool;
         return res;
     }
     Object *DictAccess(Object *first, Object *second) {
@@ -535,7 +599,7 @@ namespace Objects {
         CheckType(first, DICT);
         if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
         Object *res = Create(INT);
-        *res->_int = CustomTypes::DictSize(first->_dict);
+        res->_int = CustomTypes::DictSize(first->_dict);
         return res;
     }
     Object *DictPresent(Object *first, Object *second) {
@@ -544,7 +608,7 @@ namespace Objects {
         CheckType(first, DICT);
         if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
         Object *res = Create(BOOL);
-        *res->_bool = CustomTypes::DictPresent(first->_dict, second);
+        res->_bool = CustomTypes::DictPresent(first->_dict, second);
         return res;
     }
     void DictInsert(Object *first, Object *second, Object *third) {
@@ -566,7 +630,7 @@ namespace Objects {
         CheckNULL(first);
         CheckType(first, DICT);
         if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
-        Object *res = new Object;
+        Object *res = Pool::New<Object>();
         res->type = DICT;
         res->is_referenceable = true;
         res->_dict = CustomTypes::DictKeys(first->_dict);
@@ -576,30 +640,80 @@ namespace Objects {
         CheckNULL(first);
         CheckType(first, DICT);
         if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
-        Object *res = new Object;
+        Object *res = Pool::New<Object>();
         res->type = DICT;
         res->is_referenceable = true;
         res->_dict = CustomTypes::DictValues(first->_dict);
         return res;
     }
+    Object *DictSnapshot(Object *first) {
+        CheckNULL(first);
+        CheckType(first, DICT);
+        Object *res = Pool::New<Object>();
+        res->type = DICT;
+        res->is_referenceable = false;
+        res->_dict = CustomTypes::DictSnapshot(first->_dict);
+        return res;
+    }
+    bool DictEntryAt(Object *first, int pos, Object *&key, Object *&val) {
+        CheckNULL(first);
+        CheckType(first, DICT);
+        return CustomTypes::DictEntryAt(first->_dict, pos, key, val);
+    }
     void DictClear(Object *first) {
         CheckNULL(first);
         CheckType(first, DICT);
         if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
         CustomTypes::DictClear(first->_dict);
     }
+    void DictSort(Object *first) {
+        CheckNULL(first);
+        CheckType(first, DICT);
+        if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
+        CustomTypes::DictSort(first->_dict);
+    }
+    void DictReverse(Object *first) {
+        CheckNULL(first);
+        CheckType(first, DICT);
+        if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
+        CustomTypes::DictReverse(first->_dict);
+    }
+    Object *DictSearch(Object *first, Object *second) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckType(first, DICT);
+        CheckType(second, INT | REAL);
+        Object *res = Create(INT);
+        res->_int = CustomTypes::DictSearch(first->_dict, second);
+        return res;
+    }
+    Object *DictSum(Object *first) {
+        CheckNULL(first);
+        CheckType(first, DICT);
+        return CustomTypes::DictSum(first->_dict);
+    }
+    Object *DictMin(Object *first) {
+        CheckNULL(first);
+        CheckType(first, DICT);
+        return CustomTypes::DictMin(first->_dict);
+    }
+    Object *DictMax(Object *first) {
+        CheckNULL(first);
+        CheckType(first, DICT);
+        return CustomTypes::DictMax(first->_dict);
+    }
     Object *StringAccess(Object *first, Object *second) {
         CheckNULL(first);
         CheckNULL(second);
         CheckType(first, STRING);
         CheckType(second, INT);
         if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
-        STRING_T *str = first->_string;
-        INT_T index = *second->_int;
+        std::string_view str = View(first->_string);
+        INT_T index = second->_int;
 
-        if (!(0 <= index && index < str->size())) RuntimeError("String access out of bounds");
+        if (!(0 <= index && index < str.size())) RuntimeError("String access out of bounds");
         Object *res = Create(CHAR);
-        *res->_char = str->operator[](index);
+        res->_char = str[index];
         return res;
     }
     Object *StringSize(Object *first) {
@@ -608,7 +722,7 @@ namespace Objects {
         if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
 
         Object *res = Create(INT);
-        *res->_int = first->_string->size();
+        res->_int = View(first->_string).size();
         return res;
     }
     void StringAddSuf(Object *first, Object *second) {
@@ -618,7 +732,9 @@ namespace Objects {
         CheckType(second, STRING);
         if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
 
-        *first->_string += *second->_string;
+        StringBuffer *str = Unshare(first);
+        if (str == second->_string) str->value += STRING_T(View(str)); // the view would be invalidated by appending
+        else str->value += View(second->_string);
     }
     void StringAddPref(Object *first, Object *second) {
         CheckNULL(first);
@@ -627,7 +743,18 @@ namespace Objects {
         CheckType(second, STRING);
         if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
 
-        *first->_string = *second->_string + *first->_string;
+        STRING_T prefix(View(second->_string)); // second may share the payload of first
+        StringBuffer *str = Unshare(first);
+        if (str->start < prefix.size()) {
+            // the free space is made as large as the string, so building a string by adding prefixes takes linear time
+            size_t size = str->value.size() - str->start;
+            STRING_T value(prefix.size() + size, '\0');
+            value.append(View(str));
+            str->value.swap(value);
+            str->start = prefix.size() + size;
+        }
+        str->start -= prefix.size();
+        str->value.replace(str->start, prefix.size(), prefix);
     }
     void StringRemoveSuf(Object *first, Object *second) {
         CheckNULL(first);
@@ -636,12 +763,12 @@ namespace Objects {
         CheckType(second, INT);
         if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
 
-        STRING_T *str = first->_string;
-        INT_T n = *second->_int;
+        StringBuffer *str = Unshare(first);
+        INT_T n = second->_int;
 
-        if (n < 0 || n > str->size()) RuntimeError("Invalid number of characters to remove");
+        if (n < 0 || n > str->value.size() - str->start) RuntimeError("Invalid number of characters to remove");
 
-        str->erase(str->end() - n, str->end());
+        str->value.erase(str->value.end() - n, str->value.end());
     }
     void StringRemovePref(Object *first, Object *second) {
         CheckNULL(first);
@@ -650,12 +777,218 @@ namespace Objects {
         CheckType(second, INT);
         if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
 
-        STRING_T *str = first->_string;
-        INT_T n = *second->_int;
+        StringBuffer *str = Unshare(first);
+        INT_T n = second->_int;
+
+        if (n < 0 || n > str->value.size() - str->start) RuntimeError("Invalid number of characters to remove");
+
+        str->start += n;
+        // the removed characters are dropped once they take more space than the string, which keeps removal amortized O(1)
+        if (str->start > str->value.size() - str->start) Flatten(str);
+    }
+    static Object *WrapArray(ARRAY_T *arr) {
+        Object *res = Pool::New<Object>();
+        res->type = ARRAY;
+        res->is_referenceable = false;
+        res->_array = arr;
+        return res;
+    }
+    // shorter substrings are copied: that is as cheap as creating a view, and they don't keep their parent alive
+    static const size_t min_view_size = 32;
+
+    static Object *Substring(Object *obj, size_t begin, size_t size) {
+        Object *res = Create(STRING);
+        StringBuffer *str = obj->_string;
+        if (size < min_view_size) {
+            res->_string->value = View(str).substr(begin, size);
+            return res;
+        }
+        if (str->parent != NULL) {
+            begin += str->start;
+            str = str->parent;
+        }
+        str->refs++;
+        res->_string->parent = str;
+        res->_string->start = begin;
+        res->_string->length = size;
+        return res;
+    }
+    Object *StringSlice(Object *first, Object *second, Object *third) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckNULL(third);
+        CheckType(first, STRING);
+        CheckType(second, INT);
+        CheckType(third, INT);
+        INT_T begin = second->_int, end = third->_int;
+        if (!(0 <= begin && begin <= end && end <= View(first->_string).size())) RuntimeError("String slice out of bounds");
+        return Substring(first, begin, end - begin);
+    }
+    Object *StringFind(Object *first, Object *second, Object *third) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckType(first, STRING);
+        CheckType(second, STRING);
+        std::string_view str = View(first->_string);
+        INT_T from = 0;
+        if (third != NULL) {
+            CheckType(third, INT);
+            from = third->_int;
+            if (!(0 <= from && from <= str.size())) RuntimeError("Invalid position");
+        }
+        size_t pos = str.find(View(second->_string), from);
+        Object *res = Create(INT);
+        res->_int = pos == std::string_view::npos ? -1 : pos;
+        return res;
+    }
+    Object *StringStartsWith(Object *first, Object *second) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckType(first, STRING);
+        CheckType(second, STRING);
+        std::string_view prefix = View(second->_string);
+        Object *res = Create(BOOL);
+        res->_bool = View(first->_string).substr(0, prefix.size()) == prefix;
+        return res;
+    }
+    Object *StringSplit(Object *first, Object *second) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckType(first, STRING);
+        CheckType(second, STRING);
+        std::string_view str = View(first->_string), sep = View(second->_string);
+        if (sep.empty()) RuntimeError("Expected a non-empty separator");
+
+        Object *res = Create(DICT);
+        Object *key = Create(INT);
+        for (size_t begin = 0;; key->_int++) {
+            size_t end = std::min(str.find(sep, begin), str.size());
+            Object *part = Substring(first, begin, end - begin);
+            CustomTypes::DictInsert(res->_dict, key, part);
+            Destroy(part);
+            if (end == str.size()) break;
+            begin = end + sep.size();
+        }
+        Destroy(key);
+        return res;
+    }
+    Object *StringJoin(Object *first, Object *second) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckType(first, DICT);
+        CheckType(second, STRING);
+        std::vector<Object*> parts;
+        CustomTypes::DictElements(first->_dict, parts);
+        std::string_view sep = View(second->_string);
 
-        if (n < 0 || n > str->size()) RuntimeError("Invalid number of characters to remove");
+        size_t size = 0;
+        for (auto part: parts) {
+            if (part->type != STRING) RuntimeError("Expected string values");
+            size += View(part->_string).size() + sep.size();
+        }
+        Object *res = Create(STRING);
+        STRING_T &value = res->_string->value;
+        value.reserve(size);
+        for (size_t i = 0; i < parts.size(); i++) {
+            if (i != 0) value += sep;
+            value += View(parts[i]->_string);
+        }
+        return res;
+    }
 
-        str->erase(str->begin(), str->begin() + n);
+    Object *ArrayCreate(Object *first, bool is_real) {
+        CheckNULL(first);
+        CheckType(first, INT);
+        if (first->_int < 0) RuntimeError("Invalid array size");
+        return WrapArray(CustomTypes::ArrayCreate(is_real, first->_int));
+    }
+    Object *ArraySize(Object *first) {
+        CheckNULL(first);
+        CheckType(first, ARRAY);
+        Object *res = Create(INT);
+        res->_int = CustomTypes::ArraySize(first->_array);
+        return res;
+    }
+    Object *ArrayAccess(Object *first, Object *second) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckType(first, ARRAY);
+        CheckType(second, INT);
+        return CustomTypes::ArrayAccess(first->_array, second->_int);
+    }
+    void ArraySet(Object *first, Object *second, Object *third) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckNULL(third);
+        CheckType(first, ARRAY);
+        CheckType(second, INT);
+        if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
+        CustomTypes::ArraySet(GetMutableArray(first), second->_int, third);
+    }
+    void ArrayPush(Object *first, Object *second) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckType(first, ARRAY);
+        if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
+        CustomTypes::ArrayPush(GetMutableArray(first), second);
+    }
+    Object *ArrayPop(Object *first) {
+        CheckNULL(first);
+        CheckType(first, ARRAY);
+        if (!first->is_referenceable) RuntimeError("Expected a referenceable argument");
+        return CustomTypes::ArrayPop(GetMutableArray(first));
+    }
+    Object *ArraySlice(Object *first, Object *second, Object *third) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckNULL(third);
+        CheckType(first, ARRAY);
+        CheckType(second, INT);
+        CheckType(third, INT);
+        return WrapArray(CustomTypes::ArraySlice(first->_array, second->_int, third->_int));
+    }
+    Object *ArraySum(Object *first) {
+        CheckNULL(first);
+        CheckType(first, ARRAY);
+        return CustomTypes::ArraySum(first->_array);
+    }
+    Object *ArrayMin(Object *first) {
+        CheckNULL(first);
+        CheckType(first, ARRAY);
+        return CustomTypes::ArrayMin(first->_array);
+    }
+    Object *ArrayMax(Object *first) {
+        CheckNULL(first);
+        CheckType(first, ARRAY);
+        return CustomTypes::ArrayMax(first->_array);
+    }
+    Object *ArrayDot(Object *first, Object *second) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckType(first, ARRAY);
+        CheckType(second, ARRAY);
+        return CustomTypes::ArrayDot(first->_array, second->_array);
+    }
+    Object *ArrayAdd(Object *first, Object *second) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckType(first, ARRAY);
+        CheckType(second, ARRAY);
+        return WrapArray(CustomTypes::ArrayAdd(first->_array, second->_array));
+    }
+    Object *ArrayMul(Object *first, Object *second) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckType(first, ARRAY);
+        CheckType(second, ARRAY);
+        return WrapArray(CustomTypes::ArrayMul(first->_array, second->_array));
+    }
+    Object *ArrayScale(Object *first, Object *second) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckType(first, ARRAY);
+        CheckType(second, INT | REAL);
+        return WrapArray(CustomTypes::ArrayScale(first->_array, second));
     }
 
     bool Equal(Object *first, Object *second) {
@@ -665,19 +998,38 @@ namespace Objects {
             return false;
         }
         switch (first->type) {
-            case BOOL: return *first->_bool == *second->_bool;
-            case CHAR: return *first->_char == *second->_char;
-            case INT: return *first->_int == *second->_int;
-            case REAL: return *first->_real == *second->_real;
-            case STRING: return *first->_string == *second->_string;
-            case POINTER: return *first->_ptr == *second->_ptr;
+            case BOOL: return first->_bool == second->_bool;
+            case CHAR: return first->_char == second->_char;
+            case INT: return first->_int == second->_int;
+            case REAL: return first->_real == second->_real;
+            case STRING: {
+                StringBuffer *a = first->_string, *b = second->_string;
+                if (a == b) return true;
+                if (a->has_hash && b->has_hash && a->hash != b->hash) return false;
+                return View(a) == View(b);
+            }
+            case POINTER: return first->_ptr == second->_ptr;
             case DICT: return CustomTypes::DictEqual(first->_dict, second->_dict);
             case FUNCTION: return CustomTypes::FuncEqual(first->_func, second->_func);
+            case ARRAY: return CustomTypes::ArrayEqual(first->_array, second->_array);
         }
         
         return false;
     }
 
+    bool Less(Object *first, Object *second) {
+        CheckNULL(first);
+        CheckNULL(second);
+        CheckType(first, INT | REAL);
+        CheckType(second, INT | REAL);
+        // NaN goes after every other number, otherwise this would not be an ordering
+        if (second->type == REAL && std::isnan(second->_real)) return first->type == INT || !std::isnan(first->_real);
+        if (first->type == INT && second->type == INT) return first->_int < second->_int;
+        if (first->type == INT) return first->_int < second->_real;
+        if (second->type == INT) return first->_real < second->_int;
+        return first->_real < second->_real;
+    }
+
     const uint64_t bool_seed = 0x997810ba245f42e8ul;
     const uint64_t char_seed = 0x2b5d5602af50d4cbul;
     const uint64_t int_seed = 0x8174c17cc45eebb6ul;
@@ -688,38 +1040,44 @@ namespace Objects {
     uint64_t Hash(Object *obj) {
         CheckNULL(obj);
         switch (obj->type) {
-            case BOOL: return Hashing::Hash(bool_seed, (uint64_t)*obj->_bool);
-            case CHAR: return Hashing::Hash(char_seed, (uint64_t)*obj->_char);
-            case INT: return Hashing::Hash(int_seed, (uint64_t)*obj->_int);
-            case REAL: return Hashing::Hash(real_seed, (uint64_t)*obj->_real);
+            case BOOL: return Hashing::Hash(bool_seed, (uint64_t)obj->_bool);
+            case CHAR: return Hashing::Hash(char_seed, (uint64_t)obj->_char);
+            case INT: return Hashing::Hash(int_seed, (uint64_t)obj->_int);
+            case REAL: return Hashing::Hash(real_seed, (uint64_t)obj->_real);
             case STRING: {
-                uint64_t res = string_seed;
-                for (auto c:*obj->_string) res = Hashing::Hash(res, (uint64_t)c);
-                return res;
+                StringBuffer *str = obj->_string;
+                if (!str->has_hash) {
+                    std::string_view value = View(str);
+                    str->hash = Hashing::HashBytes(string_seed, value.data(), value.size());
+                    str->has_hash = true;
+                }
+                return str->hash;
             }
-            case POINTER: return Hashing::Hash(pointer_seed, (uint64_t)*obj->_ptr);
+            case POINTER: return Hashing::Hash(pointer_seed, (uint64_t)obj->_ptr);
             case DICT: return CustomTypes::DictHash(obj->_dict);
             case FUNCTION: return CustomTypes::FuncHash(obj->_func);
+            case ARRAY: return CustomTypes::ArrayHash(obj->_array);
         }
         return -1;
     }
 
     INT_T *IntPart(Object *first) {
-        return first->_int; // unsafe but fast, haha
+        return &first->_int; // unsafe but fast, haha
     }
 
     std::string AsString(Object *first) {
         CheckNULL(first);
         std::string res;
         switch (first->type) {
-            case BOOL: res = (*first->_bool?"true":"false"); break;
-            case CHAR: res = std::string{*first->_char}; break;
-            case INT: res = std::to_string(*first->_int); break;
-            case REAL: res = std::to_string(*first->_real); break;
-            case STRING: res = *first->_string; break;
-            case POINTER: res = std::to_string((uint64_t)*first->_ptr); break;
+            case BOOL: res = (first->_bool?"true":"false"); break;
+            case CHAR: res = std::string{first->_char}; break;
+            case INT: res = std::to_string(first->_int); break;
+            case REAL: res = std::to_string(first->_real); break;
+            case STRING: res = View(first->_string); break;
+            case POINTER: res = std::to_string((uint64_t)first->_ptr); break;
             case DICT: res = CustomTypes::DictString(first->_dict); break;
             case FUNCTION: res = "function"; break;
+            case ARRAY: res = CustomTypes::ArrayString(first->_array); break;
         }
         return res;
     }
@@ -5,7 +5,7 @@
 
 namespace Objects {
     enum Type {
-        BOOL = 1, CHAR = 2, INT = 4, REAL = 8, STRING = 16, POINTER = 32, DICT = 64, FUNCTION = 128
+        BOOL = 1, CHAR = 2, INT = 4, REAL = 8, STRING = 16, POINTER = 32, DICT = 64, FUNCTION = 128, ARRAY = 256
     };
 
     Type GetType(Object *obj);
@@ -13,16 +13,22 @@ namespace Objects {
     CHAR_T *GetChar(Object *obj);
     INT_T *GetInt(Object *obj);
     REAL_T *GetReal(Object *obj);
-    STRING_T *GetString(Object *obj);
+    const STRING_T *GetString(Object *obj);
+    STRING_T *GetMutableString(Object *obj); // clones the payload if it is shared with other copies
     PTR_T *GetPtr(Object *obj);
     DICT_T *GetDict(Object *obj);
     FUNC_T *GetFunc(Object *obj);
+    ARRAY_T *GetArray(Object *obj);
+    ARRAY_T *GetMutableArray(Object *obj); // clones the elements if they are shared with other copies
     bool IsReferenceable(Object *obj);
     void MakeReferenceable(Object *obj);
+    bool Mark(Object *obj, uint32_t epoch); // returns false if the object is already marked in this epoch
+    bool IsMarked(Object *obj, uint32_t epoch);
+    uint32_t &HeapPos(Object *obj); // used by GC
 
     Object *Create(Type type);
     void Destroy(Object *obj);
-    Object *Copy(Object *obj, bool make_referenceable); // deep copy. the copy is not added to any namespace 
+    Object *Copy(Object *obj, bool make_referenceable); // deep copy (strings are copied on write). the copy is not added to any namespace 
     void ReplaceWithCopy(Object *first, Object *second, bool make_referenceable);
 
     Object *FunctionCall(Object *first);
@@ -61,15 +67,43 @@ namespace Objects {
     void DictRemove(Object *first, Object *second);
     Object *DictKeys(Object *first);
     Object *DictValues(Object *first);
+    Object *DictSnapshot(Object *first); // see CustomTypes::DictSnapshot
+    bool DictEntryAt(Object *first, int pos, Object *&key, Object *&val);
     void DictClear(Object *first);
+    void DictSort(Object *first);
+    void DictReverse(Object *first);
+    Object *DictSearch(Object *first, Object *second);
+    Object *DictSum(Object *first);
+    Object *DictMin(Object *first);
+    Object *DictMax(Object *first);
     Object *StringAccess(Object *first, Object *second);
     Object *StringSize(Object *first);
     void StringAddSuf(Object *first, Object *second);
     void StringAddPref(Object *first, Object *second);
     void StringRemoveSuf(Object *first, Object *second);
     void StringRemovePref(Object *first, Object *second);
+    Object *StringSlice(Object *first, Object *second, Object *third); // long substrings share the payload of first
+    Object *StringFind(Object *first, Object *second, Object *third); // third is the position to start from, may be NULL
+    Object *StringStartsWith(Object *first, Object *second);
+    Object *StringSplit(Object *first, Object *second);
+    Object *StringJoin(Object *first, Object *second);
+    Object *ArrayCreate(Object *first, bool is_real);
+    Object *ArraySize(Object *first);
+    Object *ArrayAccess(Object *first, Object *second);
+    void ArraySet(Object *first, Object *second, Object *third);
+    void ArrayPush(Object *first, Object *second);
+    Object *ArrayPop(Object *first);
+    Object *ArraySlice(Object *first, Object *second, Object *third);
+    Object *ArraySum(Object *first);
+    Object *ArrayMin(Object *first);
+    Object *ArrayMax(Object *first);
+    Object *ArrayDot(Object *first, Object *second);
+    Object *ArrayAdd(Object *first, Object *second);
+    Object *ArrayMul(Object *first, Object *second);
+    Object *ArrayScale(Object *first, Object *second);
 
     bool Equal(Object *first, Object *second);
+    bool Less(Object *first, Object *second); // like CalcLt, without creating an object, NaN goes after every other number
     uint64_t Hash(Object *obj);
     std::string AsString(Object *first);
 }
\ No newline at end of file
@@ -4,11 +4,15 @@
 #include "names.hpp"
 #include "errors.hpp"
 #include "tokenizer.hpp"
+#include "gc.hpp"
+#include "compiler.hpp"
 
 #include <unordered_map>
 #include <algorithm>
 #include <iostream>
 #include <vector>
+#include <thread>
+#include <atomic>
 
 struct Node {
     Parser::NodeId id;
@@ -20,6 +24,11 @@ struct Node {
     INT_T int_literal;
     REAL_T real_literal;
     STRING_T string_literal;
+    Object *string_object = NULL;
+    std::vector<Namespaces::Address> addresses;
+    int scope_size = -1;
+    bool copies_args = false;
+    Chunk *chunk = NULL;
 };
 
 namespace Parser {
@@ -76,7 +85,7 @@ namespace Parser {
         }
         if (kw.id == Tokenizer::STRING_LITERAL) {
             res->id = STRING_LITERAL;
-            res->string_literal = kw.string_literal;
+            res->string_literal = Tokenizer::Unescape(kw.text);
 
             res->begin_in_text = tokens[start_pos].begin_in_text;
             res->end_in_text = tokens[pos].end_in_text;
@@ -152,11 +161,88 @@ namespace Parser {
 
         return NULL;
     }
+    // a part of the source between top-level forms, parsed on its own thread
+    struct Piece {
+        size_t from, to;
+        std::vector<Node*> forms;
+        bool tokenized = false, failed = false;
+        Errors::Deferred error;
+    };
+
+    static void ParsePiece(const Tokenizer::Source &source, Piece &piece) {
+        Errors::Defer(true);
+        try {
+            std::vector<Tokenizer::Token> tokens = Tokenizer::Do(source, piece.from, piece.to);
+            piece.tokenized = true;
+            int pos = 0;
+            while (pos < tokens.size()) piece.forms.push_back(Parse(tokens, pos));
+        }
+        catch (Errors::Deferred &error) {
+            piece.failed = true;
+            piece.error = error;
+        }
+        Errors::Defer(false);
+    }
+
+    // pieces smaller than this are not worth a thread
+    static const size_t min_piece_size = 1 << 20;
+
+    std::vector<Node*> ParseSource(const Tokenizer::Source &source, int threads) {
+        std::vector<Node*> res;
+        size_t parts = std::min<size_t>(4 * threads, source.size / min_piece_size);
+        if (threads <= 1 || parts <= 1) {
+            std::vector<Tokenizer::Token> tokens = Tokenizer::Do(source);
+            int pos = 0;
+            while (pos < tokens.size()) res.push_back(Parse(tokens, pos));
+            return res;
+        }
+
+        std::vector<size_t> bounds = Tokenizer::Split(source, parts);
+        std::vector<Piece> pieces(bounds.size() - 1);
+        for (size_t i = 0; i < pieces.size(); i++) {
+            pieces[i].from = bounds[i];
+            pieces[i].to = bounds[i + 1];
+        }
+
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < std::min<size_t>(threads, pieces.size()); i++) {
+            workers.emplace_back([&]() {
+                for (size_t piece = next++; piece < pieces.size(); piece = next++) ParsePiece(source, pieces[piece]);
+            });
+        }
+        for (std::thread &worker: workers) worker.join();
+
+        // the error reported is the one a single thread would find, which tokenizes the whole source first
+        for (Piece &piece: pieces) {
+            if (piece.failed && !piece.tokenized) Errors::Report(piece.error);
+        }
+        for (Piece &piece: pieces) {
+            if (piece.failed) Errors::Report(piece.error);
+        }
+
+        for (Piece &piece: pieces) res.insert(res.end(), piece.forms.begin(), piece.forms.end());
+        return res;
+    }
+
     Node *CreateNode(NodeId id) {
         Node *res = new Node;
         res->id = id;
         return res;
     }
+    bool ContainsFunc(Node *node) {
+        if (node->id == FUNC) return true;
+        for (Node *kid: node->kids) {
+            if (ContainsFunc(kid)) return true;
+        }
+        return false;
+    }
+    void Destroy(Node *node) {
+        for (Node *kid: node->kids) Destroy(kid);
+        if (node->string_object != NULL) Objects::Destroy(node->string_object);
+        if (node->chunk != NULL) Compiler::Destroy(node->chunk);
+        delete node;
+    }
     NodeId &GetId(Node *node) {
         return node->id;
     }
@@ -187,6 +273,25 @@ namespace Parser {
     STRING_T &GetString(Node *node) {
         return node->string_literal;
     }
+    Object *GetStringObject(Node *node) {
+        if (node->string_object == NULL) {
+            node->string_object = Objects::Create(Objects::STRING);
+            *Objects::GetMutableString(node->string_object) = node->string_literal;
+        }
+        return node->string_object;
+    }
+    std::vector<Namespaces::Address> &GetAddresses(Node *node) {
+        return node->addresses;
+    }
+    int &GetScopeSize(Node *node) {
+        return node->scope_size;
+    }
+    bool &GetCopiesArgs(Node *node) {
+        return node->copies_args;
+    }
+    Chunk *&GetChunk(Node *node) {
+        return node->chunk;
+    }
 
     void Highlight(Node *node) {
         Errors::Highlight(node->begin_in_text, node->end_in_text);
@@ -194,12 +299,35 @@ namespace Parser {
 
     void TryDestroying(Object *obj) {
         if (obj == NULL) return;
-        if (!Objects::IsReferenceable(obj)) {
-            Namespaces::Untrack(Namespaces::Current(), obj);
+        if (!Objects::IsReferenceable(obj) && Namespaces::Untrack(Namespaces::Current(), obj)) {
             Objects::Destroy(obj);
         }
     }
 
+    // runs a loop body or a branch of if in a namespace of its own, unless the resolver has elided it
+    static Object *ExecuteBody(Node *node, bool &do_continue, bool &do_break, bool &do_return) {
+        if (node->id == BLOCK || node->scope_size < 0) return Execute(node, do_continue, do_break, do_return);
+
+        Namespaces::Create(true, node->scope_size, node->copies_args);
+        Object *body = Execute(node, do_continue, do_break, do_return);
+        Object *ret = Namespaces::Promote(Namespaces::Parent(), body);
+        Namespaces::Destroy();
+        return ret;
+    }
+
+    // sets the object found at the addresses to a copy of value, or binds a copy to the first address
+    static void Assign(std::vector<Namespaces::Address> &addresses, Object *value) {
+        Object *first = Namespaces::Find(Namespaces::Current(), addresses);
+        if (first != NULL) {
+            Objects::ReplaceWithCopy(first, value, true);
+        }
+        else {
+            Object *value_copy = Objects::Copy(value, true);
+            Namespaces::Track(Namespaces::Current(), value_copy);
+            Namespaces::Add(Namespaces::Current(), addresses[0].slot, value_copy);
+        }
+    }
+
     Object *Execute(Node *node, bool &do_continue, bool &do_break, bool &do_return) {
         Highlight(node);
         do_continue = false;
@@ -211,22 +339,13 @@ namespace Parser {
             case SET: {
                 if (kids.size() != 2) RuntimeError("Expected 2 arguments");
                 if (kids[0]->id == NAME) {
-                    Names::Name name = kids[0]->name;
-                    
                     Object *second = Execute(kids[1], do_continue, do_break, do_return);
                     if (second == NULL) {
                         Highlight(kids[1]);
                         RuntimeError("Expected a value");
                     }
 
-                    if (Namespaces::Present(Namespaces::Current(), name)) {
-                        Objects::ReplaceWithCopy(Namespaces::Find(Namespaces::Current(), name), second, true);
-                    }
-                    else {
-                        Object *second_copy = Objects::Copy(second, true);
-                        Namespaces::Track(Namespaces::Current(), second_copy);
-                        Namespaces::Add(Namespaces::Current(), name, second_copy);
-                    }
+                    Assign(kids[0]->addresses, second);
 
                     TryDestroying(second);
                 }
@@ -258,7 +377,9 @@ namespace Parser {
             case WHILE: {
                 if (kids.size() != 2) RuntimeError("Expected 2 arguments");
 
+                int pins = Namespaces::PinCount(Namespaces::Current());
                 while (true) {
+                    GC::Poll();
                     Object *cond = Execute(kids[0], do_continue, do_break, do_return);
                     if (cond == NULL || Objects::GetType(cond) != Objects::BOOL) {
                         Highlight(kids[0]);
@@ -267,16 +388,14 @@ namespace Parser {
 
                     if (!*Objects::GetBool(cond)) {
                         TryDestroying(cond);
+                        Namespaces::Unpin(Namespaces::Current(), pins);
                         do_continue = false; do_break = false; do_return = false;
                         return NULL;
                     }
                     TryDestroying(cond);
+                    Namespaces::Unpin(Namespaces::Current(), pins);
 
-                    Namespaces::Create(true);
-                    Object *body = Execute(kids[1], do_continue, do_break, do_return);
-                    Object *ret = Objects::Copy(body, false);
-                    Namespaces::Track(Namespaces::Parent(), ret);
-                    Namespaces::Destroy();
+                    Object *ret = ExecuteBody(kids[1], do_continue, do_break, do_return);
 
                     if (do_break) {
                         do_continue = false; do_break = false; do_return = false;
@@ -293,10 +412,13 @@ namespace Parser {
             case FOR: {
                 if (kids.size() != 4) RuntimeError("Expected 4 arguments");
 
+                int pins = Namespaces::PinCount(Namespaces::Current());
                 Object *init = Execute(kids[0], do_continue, do_break, do_return);
                 TryDestroying(init);
+                Namespaces::Unpin(Namespaces::Current(), pins);
 
                 while (true) {
+                    GC::Poll();
                     Object *cond = Execute(kids[1], do_continue, do_break, do_return);
                     if (cond == NULL || Objects::GetType(cond) != Objects::BOOL) {
                         Highlight(kids[1]);
@@ -305,16 +427,14 @@ namespace Parser {
 
                     if (!*Objects::GetBool(cond)) {
                         TryDestroying(cond);
+                        Namespaces::Unpin(Namespaces::Current(), pins);
                         do_continue = false; do_break = false; do_return = false;
                         return NULL;
                     }
                     TryDestroying(cond);
+                    Namespaces::Unpin(Namespaces::Current(), pins);
 
-                    Namespaces::Create(true);
-                    Object *body = Execute(kids[3], do_continue, do_break, do_return);
-                    Object *ret = Objects::Copy(body, false);
-                    Namespaces::Track(Namespaces::Parent(), ret);
-                    Namespaces::Destroy();
+                    Object *ret = ExecuteBody(kids[3], do_continue, do_break, do_return);
 
                     if (do_break) {
                         do_continue = false; do_break = false; do_return = false;
@@ -329,17 +449,16 @@ namespace Parser {
 
                     Object *step = Execute(kids[2], do_continue, do_break, do_return);
                     TryDestroying(step);
+                    Namespaces::Unpin(Namespaces::Current(), pins);
                 }
             }
             case REPEAT: {
                 if (kids.size() != 2) RuntimeError("Expected 2 arguments");
 
+                int pins = Namespaces::PinCount(Namespaces::Current());
                 while (true) {
-                    Namespaces::Create(true);
-                    Object *body = Execute(kids[0], do_continue, do_break, do_return);
-                    Object *ret = Objects::Copy(body, false);
-                    Namespaces::Track(Namespaces::Parent(), ret);
-                    Namespaces::Destroy();
+                    GC::Poll();
+                    Object *ret = ExecuteBody(kids[0], do_continue, do_break, do_return);
 
                     if (do_break) {
                         do_continue = false; do_break = false; do_return = false;
@@ -360,12 +479,54 @@ namespace Parser {
 
                     if (*Objects::GetBool(cond)) {
                         TryDestroying(cond);
+                        Namespaces::Unpin(Namespaces::Current(), pins);
                         do_continue = false; do_break = false; do_return = false;
                         return NULL;
                     }
                     TryDestroying(cond);
+                    Namespaces::Unpin(Namespaces::Current(), pins);
                 }
             }
+            case EACH: {
+                if (kids.size() != 4) RuntimeError("Expected 4 arguments");
+                if (kids[0]->id != NAME || kids[1]->id != NAME) RuntimeError("Expected names for the key and the value");
+
+                Object *dict = Execute(kids[2], do_continue, do_break, do_return);
+                if (dict == NULL || Objects::GetType(dict) != Objects::DICT) {
+                    Highlight(kids[2]);
+                    RuntimeError("Expected a dict value");
+                }
+                Object *snapshot = Objects::DictSnapshot(dict);
+                Namespaces::Track(Namespaces::Current(), snapshot);
+                TryDestroying(dict);
+
+                int pins = Namespaces::PinCount(Namespaces::Current());
+                Object *key, *val;
+                for (int i = 0; Objects::DictEntryAt(snapshot, i, key, val); i++) {
+                    GC::Poll();
+                    Assign(kids[0]->addresses, key);
+                    Assign(kids[1]->addresses, val);
+                    Namespaces::Unpin(Namespaces::Current(), pins);
+
+                    Object *ret = ExecuteBody(kids[3], do_continue, do_break, do_return);
+
+                    if (do_break) {
+                        TryDestroying(ret);
+                        break;
+                    }
+                    if (do_return) {
+                        TryDestroying(snapshot);
+                        do_continue = false; do_break = false; do_return = true;
+                        return ret;
+                    }
+                    TryDestroying(ret);
+                }
+
+                TryDestroying(snapshot);
+                Namespaces::Unpin(Namespaces::Current(), pins);
+                do_continue = false; do_break = false; do_return = false;
+                return NULL;
+            }
             case IF: {
                 if (kids.size() != 3) RuntimeError("Expected 3 arguments");
 
@@ -378,11 +539,7 @@ namespace Parser {
                 if (*Objects::GetBool(cond)) {
                     TryDestroying(cond);
 
-                    Namespaces::Create(true);
-                    Object *body = Execute(kids[1], do_continue, do_break, do_return);
-                    Object *ret = Objects::Copy(body, false);
-                    Namespaces::Track(Namespaces::Parent(), ret);
-                    Namespaces::Destroy();
+                    Object *ret = ExecuteBody(kids[1], do_continue, do_break, do_return);
 
                     if (do_continue) {
                         do_continue = true; do_break = false; do_return = false;
@@ -403,11 +560,7 @@ namespace Parser {
                 else {
                     TryDestroying(cond);
 
-                    Namespaces::Create(true);
-                    Object *body = Execute(kids[2], do_continue, do_break, do_return);
-                    Object *ret = Objects::Copy(body, false);
-                    Namespaces::Track(Namespaces::Parent(), ret);
-                    Namespaces::Destroy();
+                    Object *ret = ExecuteBody(kids[2], do_continue, do_break, do_return);
 
                     if (do_continue) {
                         do_continue = true; do_break = false; do_return = false;
@@ -491,17 +644,15 @@ namespace Parser {
                     Object *arg = Execute(kids[i], do_continue, do_break, do_return);
                     args.push_back(arg);
                 }
-                std::reverse(args.begin(), args.end());
 
-                Namespaces::Create(false);
-                for (auto arg: args) {
-                    arg = Objects::Copy(arg, true);
-                    Namespaces::Track(Namespaces::Current(), arg);
-                    Namespaces::PushOnStack(Namespaces::Current(), arg);
+                GC::Poll();
+                Namespaces::Create(false, 0);
+                // the first argument ends up on top of the stack
+                for (int i = (int)args.size() - 1; i >= 0; i--) {
+                    if (!Namespaces::PushArg(args[i])) args[i] = NULL;
                 }
                 Object *ret = CustomTypes::FuncCall(Objects::GetFunc(func));
-                Object *res = Objects::Copy(ret, false);
-                Namespaces::Track(Namespaces::Parent(), res);
+                Object *res = Namespaces::Promote(Namespaces::Parent(), ret);
                 Namespaces::Destroy();
 
                 for (auto arg: args) TryDestroying(arg);
@@ -580,6 +731,7 @@ namespace Parser {
                 }
 
                 Object *res = Objects::Deref(arg);
+                Namespaces::Pin(Namespaces::Current(), res);
                 TryDestroying(arg);
 
                 do_continue = false; do_break = false; do_return = false;
@@ -696,6 +848,7 @@ namespace Parser {
                 Object *arg = Execute(kids[1], do_continue, do_break, do_return);
 
                 Object *res = Objects::DictAccess(dict, arg);
+                Namespaces::Pin(Namespaces::Current(), res);
 
                 TryDestroying(dict);
                 TryDestroying(arg);
@@ -966,8 +1119,7 @@ namespace Parser {
                 return res;
             }
             case STRING_LITERAL: {
-                Object *res = Objects::Create(Objects::STRING);
-                *Objects::GetString(res) = node->string_literal;
+                Object *res = Objects::Copy(GetStringObject(node), false);
                 Namespaces::Track(Namespaces::Current(), res);
                 do_continue = false; do_break = false; do_return = false;
                 return res;
@@ -986,14 +1138,19 @@ namespace Parser {
                 return res;
             }
             case NAME: {
-                Object *res = Namespaces::Find(Namespaces::Current(), node->name);
+                Object *res = Namespaces::Find(Namespaces::Current(), node->addresses);
+                if (res == NULL) RuntimeError("Couldn't find object by name " + std::string(node->name.str));
                 do_continue = false; do_break = false; do_return = false;
                 return res;
             }
             case BLOCK: {
-                Namespaces::Create(true);
+                // the body of a function and elided blocks have no namespace of their own
+                bool opens_scope = node->scope_size >= 0;
+                if (opens_scope) Namespaces::Create(true, node->scope_size, node->copies_args);
                 Object *ret = NULL;
+                int pins = Namespaces::PinCount(Namespaces::Current());
                 for (auto kid: kids) {
+                    Namespaces::Unpin(Namespaces::Current(), pins);
                     Object *res = Execute(kid, do_continue, do_break, do_return);
                     if (do_continue) {
                         do_continue = true; do_break = false; do_return = false;
@@ -1007,14 +1164,13 @@ namespace Parser {
                     }
                     if (do_return) {
                         do_continue = false; do_break = false; do_return = true;
-                        ret = Objects::Copy(res, false);
-                        Namespaces::Track(Namespaces::Parent(), ret);
-                        TryDestroying(res);
+                        ret = Namespaces::Promote(opens_scope ? Namespaces::Parent() : Namespaces::Current(), res);
+                        if (ret != res) TryDestroying(res);
                         break;
                     }
                     TryDestroying(res);
                 }
-                Namespaces::Destroy();
+                if (opens_scope) Namespaces::Destroy();
                 return ret;
             }
         }
@@ -8,9 +8,14 @@
 
 #include "objects.hpp"
 #include "tokenizer.hpp"
+
+namespace Namespaces {
+    struct Address;
+}
+
 namespace Parser {
     enum NodeId {
-        SET, WHILE, FOR, REPEAT, IF, CONTINUE, BREAK, RETURN, FUNC, ARG, CALL,
+        SET, WHILE, FOR, REPEAT, EACH, IF, CONTINUE, BREAK, RETURN, FUNC, ARG, CALL,
         BOOL_CAST, CHAR_CAST, INT_CAST, REAL_CAST, STRING_CAST, DEREF, REF, 
         INV, NOT, NEG, MULT, DIV, REM, ADD, SUB, SHL, SHR, LT, GT, LE, GE, 
         EQ, NEQ, AND, XOR, OR, CONJ, DISJ, DACCESS, DSIZE, DPRESENT, DINSERT, 
@@ -20,7 +25,11 @@ namespace Parser {
     };  
 
     Node *Parse(std::vector<Tokenizer::Token> &tokens, int &pos);
+    // top-level forms of the whole source, pieces of a large source are parsed on up to threads threads
+    std::vector<Node*> ParseSource(const Tokenizer::Source &source, int threads);
     Node *CreateNode(NodeId id);
+    bool ContainsFunc(Node *node);
+    void Destroy(Node *node); // frees the tree with its literals and bytecode
     NodeId &GetId(Node *node);
     std::vector<Node*> &GetKids(Node *node);
     int &GetBeginInText(Node *node);
@@ -31,6 +40,13 @@ namespace Parser {
     INT_T &GetInt(Node *node);
     REAL_T &GetReal(Node *node);
     STRING_T &GetString(Node *node);
+    Object *GetStringObject(Node *node); // holds the literal, copies of it share the payload and its cached hash
+    std::vector<Namespaces::Address> &GetAddresses(Node *node); // set by Resolver for names
+    int &GetScopeSize(Node *node); // number of slots in the namespace opened by the node, or -1
+    bool &GetCopiesArgs(Node *node); // whether the namespace opened by the node needs its own copies of the arguments
+    Chunk *&GetChunk(Node *node); // bytecode compiled from this node, if any
+
+    void TryDestroying(Object *obj); // destroys obj if it is a temporary tracked in the current namespace
     
     // returned value is tracked in the topmost namespace before the call
     Object *Execute(Node *node, bool &do_continue, bool &do_break, bool &do_return);
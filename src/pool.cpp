@@ -0,0 +1,73 @@
+#include "pool.hpp"
+
+namespace Pool {
+    const size_t granularity = 16;
+    const int size_classes = 16; // blocks of up to 256 bytes
+    const size_t slab_size = 1 << 16;
+
+    struct Block {
+        Block *next;
+    };
+    struct SizeClass {
+        Block *free;
+        uint64_t slabs, in_use, peak, allocations;
+    };
+
+    static thread_local SizeClass classes[size_classes];
+
+    static void Refill(SizeClass &cls, size_t block_size) {
+        char *slab = (char*)::operator new(slab_size);
+        cls.slabs++;
+        for (size_t offset = 0; offset + block_size <= slab_size; offset += block_size) {
+            Block *block = (Block*)(slab + offset);
+            block->next = cls.free;
+            cls.free = block;
+        }
+    }
+
+    void *Allocate(size_t size) {
+        if (size == 0) size = 1;
+        if (size > granularity * size_classes) return ::operator new(size);
+
+        int index = (size - 1) / granularity;
+        SizeClass &cls = classes[index];
+        if (cls.free == NULL) Refill(cls, (index + 1) * granularity);
+
+        Block *block = cls.free;
+        cls.free = block->next;
+        cls.allocations++;
+        if (++cls.in_use > cls.peak) cls.peak = cls.in_use;
+        return block;
+    }
+    void Free(void *ptr, size_t size) {
+        if (ptr == NULL) return;
+        if (size == 0) size = 1;
+        if (size > granularity * size_classes) {
+            ::operator delete(ptr);
+            return;
+        }
+
+        SizeClass &cls = classes[(size - 1) / granularity];
+        Block *block = (Block*)ptr;
+        block->next = cls.free;
+        cls.free = block;
+        cls.in_use--;
+    }
+
+    int SizeClasses() {
+        return size_classes;
+    }
+    Stats GetStats(int size_class) {
+        SizeClass &cls = classes[size_class];
+        return {(size_class + 1) * granularity, cls.slabs, cls.in_use, cls.peak, cls.allocations};
+    }
+    void PrintStats(std::ostream &out) {
+        out << "pool: block size, slabs, in use, peak, allocations\n";
+        for (int i = 0; i < size_classes; i++) {
+            Stats stats = GetStats(i);
+            if (stats.slabs == 0) continue;
+            out << "pool: " << stats.block_size << ", " << stats.slabs << ", " << stats.in_use << ", "
+                << stats.peak << ", " << stats.allocations << "\n";
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <ostream>
+#include <utility>
+
+namespace Pool {
+
+    /*
+
+    small blocks are allocated from slabs and recycled through free lists, one list per size class.
+    free lists are thread-local, a block has to be freed by the thread which allocated it.
+    blocks larger than the largest size class go to the global operator new.
+
+    */
+    void *Allocate(size_t size);
+    void Free(void *ptr, size_t size);
+
+    struct Stats {
+        size_t block_size;
+        uint64_t slabs; // slabs carved into blocks of this size
+        uint64_t in_use; // blocks currently allocated
+        uint64_t peak; // largest number of blocks allocated at once
+        uint64_t allocations; // total number of allocations
+    };
+    int SizeClasses();
+    Stats GetStats(int size_class); // for the current thread
+    void PrintStats(std::ostream &out);
+
+    template<typename T, typename... Args>
+    T *New(Args&&... args) {
+        return new (Allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    }
+    template<typename T>
+    void Delete(T *ptr) {
+        ptr->~T();
+        Free(ptr, sizeof(T));
+    }
+
+    // allocator for standard containers
+    template<typename T>
+    struct Allocator {
+        using value_type = T;
+
+        Allocator() = default;
+        template<typename U>
+        Allocator(const Allocator<U> &) {}
+
+        T *allocate(size_t n) {
+            return (T*)Allocate(n * sizeof(T));
+        }
+        void deallocate(T *ptr, size_t n) {
+            Free(ptr, n * sizeof(T));
+        }
+
+        template<typename U>
+        bool operator==(const Allocator<U> &) const { return true; }
+        template<typename U>
+        bool operator!=(const Allocator<U> &) const { return false; }
+    };
+}
@@ -40,7 +40,7 @@ char getch() {
 
 namespace Predefined {
     void InstallSingle(Names::Name name, Object *obj) {
-        Namespaces::Add(Namespaces::Current(), name, obj);
+        Namespaces::Add(Namespaces::Current(), name.id, obj);
         Namespaces::Track(Namespaces::Current(), obj);
     }
 
@@ -56,6 +56,7 @@ namespace Predefined {
             Object *arg = Namespaces::AccessStack(Namespaces::Current(), i);
             Object *str_version = Objects::CastToString(arg);
             std::cout << *Objects::GetString(str_version);
+            Objects::Destroy(str_version);
         }
         return NULL;
     }
@@ -65,6 +66,7 @@ namespace Predefined {
             Object *arg = Namespaces::AccessStack(Namespaces::Current(), i);
             Object *str_version = Objects::CastToString(arg);
             std::cout << *Objects::GetString(str_version);
+            Objects::Destroy(str_version);
         }
         std::cout << std::endl;
         return NULL;
@@ -223,6 +225,55 @@ namespace Predefined {
         return res;
     }
 
+    static Object *Arg(int pos) {
+        return Namespaces::AccessStack(Namespaces::Current(), pos);
+    }
+
+    static Object *Result(Object *res) {
+        Namespaces::Track(Namespaces::Current(), res);
+        return res;
+    }
+
+    // functions which modify an array get a pointer to it, since arguments are copies
+    Object *_IntArray() { return Result(Objects::ArrayCreate(Arg(0), false)); }
+    Object *_RealArray() { return Result(Objects::ArrayCreate(Arg(0), true)); }
+    Object *_ASize() { return Result(Objects::ArraySize(Arg(0))); }
+    Object *_AGet() { return Result(Objects::ArrayAccess(Arg(0), Arg(1))); }
+    Object *_ASet() { Objects::ArraySet(Objects::Deref(Arg(0)), Arg(1), Arg(2)); return NULL; }
+    Object *_APush() { Objects::ArrayPush(Objects::Deref(Arg(0)), Arg(1)); return NULL; }
+    Object *_APop() { return Result(Objects::ArrayPop(Objects::Deref(Arg(0)))); }
+    Object *_ASlice() { return Result(Objects::ArraySlice(Arg(0), Arg(1), Arg(2))); }
+    Object *_ASum() { return Result(Objects::ArraySum(Arg(0))); }
+    Object *_AMin() { return Result(Objects::ArrayMin(Arg(0))); }
+    Object *_AMax() { return Result(Objects::ArrayMax(Arg(0))); }
+    Object *_ADot() { return Result(Objects::ArrayDot(Arg(0), Arg(1))); }
+    Object *_AAdd() { return Result(Objects::ArrayAdd(Arg(0), Arg(1))); }
+    Object *_AMul() { return Result(Objects::ArrayMul(Arg(0), Arg(1))); }
+    Object *_AScale() { return Result(Objects::ArrayScale(Arg(0), Arg(1))); }
+
+    // functions which only read a dict also take a pointer to it, which saves copying the dict
+    static Object *DictArg(int pos) {
+        Object *arg = Arg(pos);
+        if (Objects::GetType(arg) == Objects::POINTER) return Objects::Deref(arg);
+        return arg;
+    }
+
+    Object *_DSort() { Objects::DictSort(Objects::Deref(Arg(0))); return NULL; }
+    Object *_DReverse() { Objects::DictReverse(Objects::Deref(Arg(0))); return NULL; }
+    Object *_DSearch() { return Result(Objects::DictSearch(DictArg(0), Arg(1))); }
+    Object *_DSum() { return Result(Objects::DictSum(DictArg(0))); }
+    Object *_DMin() { return Result(Objects::DictMin(DictArg(0))); }
+    Object *_DMax() { return Result(Objects::DictMax(DictArg(0))); }
+
+    Object *_Substr() { return Result(Objects::StringSlice(Arg(0), Arg(1), Arg(2))); }
+    Object *_Find() {
+        Object *from = Namespaces::StackSize(Namespaces::Current()) > 2 ? Arg(2) : NULL;
+        return Result(Objects::StringFind(Arg(0), Arg(1), from));
+    }
+    Object *_StartsWith() { return Result(Objects::StringStartsWith(Arg(0), Arg(1))); }
+    Object *_Split() { return Result(Objects::StringSplit(Arg(0), Arg(1))); }
+    Object *_Join() { return Result(Objects::StringJoin(DictArg(0), Arg(1))); }
+
 
     void Install() {
         InstallFunc("print", _Print);
@@ -237,5 +288,31 @@ namespace Predefined {
         InstallFunc("abs", _Abs);
         InstallFunc("clearterminal", _ClearTerminal);
         InstallFunc("getch", _Getch);
+        InstallFunc("intarray", _IntArray);
+        InstallFunc("realarray", _RealArray);
+        InstallFunc("asize", _ASize);
+        InstallFunc("aget", _AGet);
+        InstallFunc("aset", _ASet);
+        InstallFunc("apush", _APush);
+        InstallFunc("apop", _APop);
+        InstallFunc("aslice", _ASlice);
+        InstallFunc("asum", _ASum);
+        InstallFunc("amin", _AMin);
+        InstallFunc("amax", _AMax);
+        InstallFunc("adot", _ADot);
+        InstallFunc("aadd", _AAdd);
+        InstallFunc("amul", _AMul);
+        InstallFunc("ascale", _AScale);
+        InstallFunc("dsort", _DSort);
+        InstallFunc("dreverse", _DReverse);
+        InstallFunc("dsearch", _DSearch);
+        InstallFunc("dsum", _DSum);
+        InstallFunc("dmin", _DMin);
+        InstallFunc("dmax", _DMax);
+        InstallFunc("substr", _Substr);
+        InstallFunc("find", _Find);
+        InstallFunc("startswith", _StartsWith);
+        InstallFunc("split", _Split);
+        InstallFunc("join", _Join);
     }
 }
\ No newline at end of file
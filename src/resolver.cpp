@@ -0,0 +1,155 @@
+#include "resolver.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+#include "parser.hpp"
+#include "namespaces.hpp"
+
+namespace Resolver {
+    struct Scope {
+        std::unordered_map<uint64_t, int> slots;
+        Scope *parent; // NULL for namespace 0 and for the namespace of a function call
+        bool is_global;
+        bool modifies_args; // the scope would modify its copies of the arguments
+        bool escapes_args; // the function takes a pointer to an argument somewhere, so its nested scopes can't share them
+        bool is_elided; // the scope runs in the namespace of its parent
+    };
+
+    // whether kid i of the node runs in a namespace of its own
+    static bool OpensScope(Node *node, size_t i) {
+        std::vector<Node*> &kids = Parser::GetKids(node);
+        switch (Parser::GetId(node)) {
+            case Parser::WHILE: {
+                if (kids.size() == 2 && i == 1) return true;
+                break;
+            }
+            case Parser::FOR: {
+                if (kids.size() == 4 && i == 3) return true;
+                break;
+            }
+            case Parser::REPEAT: {
+                if (kids.size() == 2 && i == 0) return true;
+                break;
+            }
+            case Parser::EACH: {
+                if (kids.size() == 4 && i == 3) return true;
+                break;
+            }
+            case Parser::IF: {
+                if (kids.size() == 3 && (i == 1 || i == 2)) return true;
+                break;
+            }
+            default: break;
+        }
+        return Parser::GetId(kids[i]) == Parser::BLOCK;
+    }
+
+    static bool ContainsArg(Node *node) {
+        if (Parser::GetId(node) == Parser::FUNC) return false;
+        if (Parser::GetId(node) == Parser::ARG) return true;
+        for (auto kid: Parser::GetKids(node)) {
+            if (ContainsArg(kid)) return true;
+        }
+        return false;
+    }
+
+    // whether the first kid of the node is modified by it
+    static bool ModifiesFirstKid(Node *node) {
+        switch (Parser::GetId(node)) {
+            case Parser::SET: case Parser::REF: case Parser::DINSERT: case Parser::DREMOVE: case Parser::DCLEAR:
+            case Parser::SADDSUF: case Parser::SADDPREF: case Parser::SREMOVESUF: case Parser::SREMOVEPREF:
+                return !Parser::GetKids(node).empty();
+            default: break;
+        }
+        return false;
+    }
+
+    // whether the node or a kid of it, in any scope of the same function, takes a pointer to an argument
+    static bool RefsArg(Node *node) {
+        std::vector<Node*> &kids = Parser::GetKids(node);
+        if (Parser::GetId(node) == Parser::FUNC) return false;
+        if (Parser::GetId(node) == Parser::REF && !kids.empty() && ContainsArg(kids[0])) return true;
+        for (auto kid: kids) {
+            if (RefsArg(kid)) return true;
+        }
+        return false;
+    }
+
+    static void Bind(Node *name, Scope *scope) {
+        if (Parser::GetId(name) != Parser::NAME) return;
+        uint64_t id = Parser::GetName(name).id;
+        if (!scope->is_global && scope->slots.find(id) == scope->slots.end()) {
+            int slot = scope->slots.size();
+            scope->slots[id] = slot;
+        }
+    }
+
+    // gives slots to the names set by the node and by its kids running in the same scope
+    static void Collect(Node *node, Scope *scope) {
+        std::vector<Node*> &kids = Parser::GetKids(node);
+        if (Parser::GetId(node) == Parser::FUNC) return;
+        if (ModifiesFirstKid(node) && ContainsArg(kids[0])) scope->modifies_args = true;
+        if (Parser::GetId(node) == Parser::SET && kids.size() == 2) Bind(kids[0], scope);
+        if (Parser::GetId(node) == Parser::EACH && kids.size() == 4) {
+            Bind(kids[0], scope);
+            Bind(kids[1], scope);
+        }
+        for (size_t i = 0; i < kids.size(); i++) {
+            if (!OpensScope(node, i)) Collect(kids[i], scope);
+        }
+    }
+
+    static void Visit(Node *node, Scope *scope);
+
+    static void VisitScope(Node *node, Scope *parent) {
+        Scope scope{{}, parent, false, false, parent->escapes_args, false};
+        Collect(node, &scope);
+        // a scope which modifies the arguments needs copies of its own, so it isn't elided
+        scope.is_elided = scope.slots.empty() && !scope.modifies_args;
+        Visit(node, &scope);
+        Parser::GetScopeSize(node) = scope.is_elided ? -1 : scope.slots.size();
+        // a write through a pointer to an argument must not show in scopes opened before it
+        Parser::GetCopiesArgs(node) = scope.modifies_args || (scope.escapes_args && !scope.is_elided);
+    }
+    static void VisitFunction(Node *node) {
+        Scope scope{{}, NULL, false, false, RefsArg(node), false};
+        Collect(node, &scope);
+        Visit(node, &scope);
+    }
+
+    static void Visit(Node *node, Scope *scope) {
+        std::vector<Node*> &kids = Parser::GetKids(node);
+        switch (Parser::GetId(node)) {
+            case Parser::NAME: {
+                uint64_t id = Parser::GetName(node).id;
+                std::vector<Namespaces::Address> &addresses = Parser::GetAddresses(node);
+                addresses.clear();
+
+                int depth = 0;
+                for (Scope *cur = scope; cur != NULL && !cur->is_global; cur = cur->parent) {
+                    if (cur->is_elided) continue;
+                    if (cur->slots.find(id) != cur->slots.end()) addresses.push_back({depth, cur->slots[id]});
+                    depth++;
+                }
+                addresses.push_back({-1, (int)id});
+                return;
+            }
+            case Parser::FUNC: {
+                if (kids.size() == 1) VisitFunction(kids[0]);
+                return;
+            }
+            default: break;
+        }
+        for (size_t i = 0; i < kids.size(); i++) {
+            if (OpensScope(node, i)) VisitScope(kids[i], scope);
+            else Visit(kids[i], scope);
+        }
+    }
+
+    void Resolve(Node *node) {
+        Scope global{{}, NULL, true, false, RefsArg(node), false};
+        if (Parser::GetId(node) == Parser::BLOCK) VisitScope(node, &global);
+        else Visit(node, &global);
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "util.hpp"
+
+namespace Resolver {
+
+    /*
+
+    resolver is run on every top-level node before it is executed.
+
+    every name is given a list of addresses where its object can be found:
+    slots of the enclosing namespaces that may bind it (innermost first), then namespace 0.
+    a name that is set (or bound by each) gets a slot in the namespace it is set in,
+    unless that is namespace 0, where slots are indexed by name ids.
+
+    namespaces are opened by blocks and by loop bodies and branches of if which are not blocks.
+    a block that is the body of a function runs in the namespace created by the call.
+    a scope which sets no names is elided: it runs in the namespace of its parent and its scope size is -1.
+    other scopes read the arguments of their parent in place, unless they modify them.
+
+    */
+    void Resolve(Node *node);
+}
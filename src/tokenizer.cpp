@@ -1,30 +1,85 @@
 #include "tokenizer.hpp"
 
 #include <string>
-#include <cctype>
-#include <algorithm>
+#include <cstdlib>
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "errors.hpp"
 
 namespace Tokenizer {
-    const std::vector<std::string> keywords = {
-        "set", "while", "for", "repeat", "if", "continue", "break", "return", "func",
+    constexpr std::string_view keywords[] = {
+        "set", "while", "for", "repeat", "each", "if", "continue", "break", "return", "func",
         "arg", "call", "bool", "char", "int", "real", "string", "deref", "ref", "inv",
         "not", "neg", "mult", "div", "rem", "add", "sub", "shl", "shr", "lt", "gt", "le",
         "ge", "eq", "neq", "and", "xor", "or", "conj", "disj", "[d]", "[dn]", "[d?]",
-        "[d+]", "[d-]", "[dk]", "[dv]", "[dc]", "[s]", "[sn]", "[s+]", "[+s]", "[s-]", 
-        "[-s]", "(", ")"
+        "[d+]", "[d-]", "[dk]", "[dv]", "[dc]", "[s]", "[sn]", "[s+]", "[+s]", "[s-]",
+        "[-s]"
     };
+    constexpr int num_keywords = sizeof(keywords) / sizeof(keywords[0]);
+    static_assert(num_keywords == OPEN_BRACKET, "keywords must follow TokenId");
 
-    bool IsKeyword(std::string s) {
-        return std::find(keywords.begin(), keywords.end(), s) != keywords.end();
+    // keywords are 2..8 characters long and differ in their length and first and last
+    // two characters, which the hash mixes into a slot of a small table
+    constexpr size_t min_keyword_size = 2, max_keyword_size = 8;
+    constexpr int table_size = 128;
+
+    constexpr int KeywordHash(std::string_view s) {
+        size_t n = s.size();
+        return (2 * (unsigned char)s[0] + 16 * (unsigned char)s[1] + 5 * (unsigned char)s[n - 2]
+                + 4 * (unsigned char)s[n - 1] + n) & (table_size - 1);
     }
 
-    int KeywordId(std::string s) {
-        return std::find(keywords.begin(), keywords.end(), s) - keywords.begin();
+    struct KeywordTable {
+        signed char slots[table_size];
+        bool perfect;
+    };
+    constexpr KeywordTable BuildKeywordTable() {
+        KeywordTable table{};
+        for (int i = 0; i < table_size; i++) table.slots[i] = -1;
+        table.perfect = true;
+        for (int i = 0; i < num_keywords; i++) {
+            int slot = KeywordHash(keywords[i]);
+            if (table.slots[slot] != -1) table.perfect = false;
+            table.slots[slot] = i;
+        }
+        return table;
     }
+    constexpr KeywordTable keyword_table = BuildKeywordTable();
+    static_assert(keyword_table.perfect, "keyword hash has a collision");
 
-    bool IsBool(std::string &s, BOOL_T &res) {
+    int KeywordId(std::string_view s) {
+        if (s.size() < min_keyword_size || s.size() > max_keyword_size) return -1;
+        int id = keyword_table.slots[KeywordHash(s)];
+        if (id == -1 || keywords[id] != s) return -1;
+        return id;
+    }
+
+    enum CharClass : unsigned char {
+        WORD_CHAR, SPACE_CHAR, OPEN_CHAR, CLOSE_CHAR, STRING_QUOTE, CHAR_QUOTE,
+    };
+    struct CharTable {
+        CharClass classes[256];
+    };
+    constexpr CharTable BuildCharTable() {
+        CharTable table{};
+        for (int c: {' ', '\t', '\n', '\v', '\f', '\r'}) table.classes[c] = SPACE_CHAR;
+        table.classes['('] = OPEN_CHAR;
+        table.classes[')'] = CLOSE_CHAR;
+        table.classes['"'] = STRING_QUOTE;
+        table.classes['\''] = CHAR_QUOTE;
+        return table;
+    }
+    constexpr CharTable char_table = BuildCharTable();
+
+    inline CharClass Class(char c) {
+        return char_table.classes[(unsigned char)c];
+    }
+
+    bool IsBool(std::string_view s, BOOL_T &res) {
         if (s == "true") {
             res = true;
             return true;
@@ -35,211 +90,322 @@ namespace Tokenizer {
         }
         return false;
     }
-    bool IsInt(std::string &s, INT_T &res) {
-        size_t pos;
-        try {
-            res = std::stoll(s, &pos);
-            if (pos != s.size()) return false;
-            return true;
-        } 
-        catch (...) {
-            return false;
+    enum NumberKind {
+        NOT_A_NUMBER, INT_NUMBER, REAL_NUMBER, MALFORMED_NUMBER,
+    };
+
+    inline bool IsDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    bool IsSpecialReal(std::string_view s) {
+        if (s.size() != 3 && s.size() != 8) return false;
+        char lower[8];
+        for (size_t i = 0; i < s.size(); i++) lower[i] = s[i] | 0x20;
+        std::string_view word(lower, s.size());
+        return word == "inf" || word == "nan" || word == "infinity";
+    }
+
+    // [+-] digits [. digits] [(e|E) [+-] digits], with at least one digit before the exponent.
+    // words that do not start like a number are names, ones that start like a number but
+    // break the pattern are malformed, and stop is set to the first offending character
+    NumberKind ScanNumber(std::string_view s, size_t &stop) {
+        size_t i = 0, n = s.size();
+        if (i < n && (s[i] == '+' || s[i] == '-')) i++;
+        if (IsSpecialReal(s.substr(i))) return REAL_NUMBER;
+
+        size_t digits = 0;
+        while (i < n && IsDigit(s[i])) i++, digits++;
+        NumberKind kind = INT_NUMBER;
+        if (i < n && s[i] == '.') {
+            kind = REAL_NUMBER;
+            i++;
+            while (i < n && IsDigit(s[i])) i++, digits++;
         }
-        return false;
+        if (digits == 0) return NOT_A_NUMBER;
+
+        if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+            kind = REAL_NUMBER;
+            size_t exponent = i++;
+            if (i < n && (s[i] == '+' || s[i] == '-')) i++;
+            size_t exponent_digits = 0;
+            while (i < n && IsDigit(s[i])) i++, exponent_digits++;
+            if (exponent_digits == 0) {
+                stop = exponent;
+                return MALFORMED_NUMBER;
+            }
+        }
+        if (i != n) {
+            stop = i;
+            return MALFORMED_NUMBER;
+        }
+        return kind;
     }
-    bool IsReal(std::string &s, REAL_T &res) {
-        size_t pos;
-        try {
-            res = std::stod(s, &pos);
-            if (pos != s.size()) return false;
-            return true;
-        } 
-        catch (...) {
-            return false;
+
+    bool IsNumber(std::string_view s, Token &token) {
+        size_t stop;
+        NumberKind kind = ScanNumber(s, stop);
+        if (kind == NOT_A_NUMBER) return false;
+        if (kind == MALFORMED_NUMBER) {
+            Highlight(token.begin_in_text + stop, token.end_in_text);
+            TokenizationError("Malformed number");
         }
-        return false;
+
+        // from_chars does not take a leading plus
+        const char *first = s.data() + (s[0] == '+'), *last = s.data() + s.size();
+        if (kind == INT_NUMBER) {
+            std::from_chars_result res = std::from_chars(first, last, token.int_literal);
+            if (res.ec == std::errc()) {
+                token.id = INT_LITERAL;
+                return true;
+            }
+            // too large for an int, so it is read as a real
+        }
+
+        std::from_chars_result res = std::from_chars(first, last, token.real_literal);
+        if (res.ec != std::errc()) {
+            Highlight(token.begin_in_text, token.end_in_text);
+            TokenizationError("Number is out of range");
+        }
+        token.id = REAL_LITERAL;
+        return true;
     }
-    bool IsNULL(std::string &s) {
+    bool IsNULL(std::string_view s) {
         return s == "NULL";
     }
-    bool IsDict(std::string &s) {
+    bool IsDict(std::string_view s) {
         return s == "{}";
     }
 
-    std::vector<Token> Do(std::fstream &fd) {
-        std::vector<Token> res;
-        std::string stack;
-        int pos;
+    bool Load(const char *file, Source &source) {
+        source = Source{NULL, 0, false};
+        int fd = open(file, O_RDONLY);
+        if (fd == -1) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            close(fd);
+            return false;
+        }
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                madvise(data, st.st_size, MADV_SEQUENTIAL);
+                source = Source{(const char*)data, (size_t)st.st_size, true};
+                close(fd);
+                return true;
+            }
+        }
+
+        // pipes and the like cannot be mapped, so they are read into a buffer
+        size_t capacity = 1 << 16;
+        char *buffer = (char*)malloc(capacity);
         while (true) {
-            pos = fd.tellg();
-            char c = fd.get();
-            if (fd.fail() || c == EOF) break;
-            if (isspace(c)) {
-                if (stack.empty()) continue;
-
-                for (auto kw: keywords) {
-                    if (stack != kw) continue;    
-                    res.push_back(Token{(TokenId)KeywordId(kw), 0, 0, 0, 0, "", 
-                                        {}, pos - (int)kw.size() + 1, pos});
-                    stack = "";
-                    break;
-                }
-                if (!stack.empty())
-                res.push_back(Token{NAME, 0, 0, 0, 0, "", 
-                            Names::GetName(stack), pos - (int)stack.size(), pos - 1});
-                stack = "";
-                continue;
+            if (source.size == capacity) {
+                capacity *= 2;
+                buffer = (char*)realloc(buffer, capacity);
             }
-            
-            if (c == '\"') {
-                Token token;
-                token.id = STRING_LITERAL;
-                token.begin_in_text = pos;
-
-                while (true) {
-                    pos = fd.tellg();
-                    c = fd.get();
-                    if (fd.fail() || c == EOF) {
-                        Highlight(token.begin_in_text, pos);
-                        TokenizationError("Expected a double quote");
-                    }
+            ssize_t got = read(fd, buffer + source.size, capacity - source.size);
+            if (got == -1) {
+                free(buffer);
+                close(fd);
+                return false;
+            }
+            if (got == 0) break;
+            source.size += got;
+        }
+        source.data = buffer;
+        close(fd);
+        return true;
+    }
+    void Unload(Source &source) {
+        if (source.mapped) munmap((void*)source.data, source.size);
+        else free((void*)source.data);
+        source = Source{NULL, 0, false};
+    }
 
-                    if (c == '\\') {
-                        pos = fd.tellg();
-                        c = fd.get();
-                        if (fd.fail() || c == EOF) {
-                            Highlight(token.begin_in_text, pos);
-                            TokenizationError("Expected a character");
-                        }
-                        if (c == 'n') token.string_literal += '\n';
-                        else if (c == 't') token.string_literal += '\t';
-                        else if (c == 'r') token.string_literal += '\r';
-                        else if (c == 'b') token.string_literal += '\b';
-                        else token.string_literal += c;
-                    }
-                    else if (c == '"') {
-                        break;
-                    }
-                    else {
-                        token.string_literal += c;
-                    }
-                }
+    Token MakeToken(TokenId id, int begin_in_text, int end_in_text) {
+        Token token;
+        token.id = id;
+        token.begin_in_text = begin_in_text;
+        token.end_in_text = end_in_text;
+        return token;
+    }
 
-                token.end_in_text = pos;
-                res.push_back(token);
-                continue;
-            }
-            if (c == '\'') {
-                Token token;
-                token.id = CHAR_LITERAL;
-                token.begin_in_text = pos;
-
-                pos = fd.tellg();
-                c = fd.get();
-                if (fd.fail() || c == EOF) {
-                    Highlight(token.begin_in_text, pos);
-                    TokenizationError("Expected a character");
-                }
+    Token WordToken(std::string_view word, int begin_in_text) {
+        Token token = MakeToken(NAME, begin_in_text, begin_in_text + (int)word.size() - 1);
+
+        if (IsNumber(word, token)) return token;
+
+        int id = KeywordId(word);
+        if (id != -1) token.id = (TokenId)id;
+        else if (IsBool(word, token.bool_literal)) token.id = BOOL_LITERAL;
+        else if (IsNULL(word)) token.id = NULL_LITERAL;
+        else if (IsDict(word)) token.id = DICT_LITERAL;
+        else token.name = Names::GetName(word);
+        return token;
+    }
+
+    char EscapedChar(char c) {
+        if (c == 'n') return '\n';
+        if (c == 't') return '\t';
+        if (c == 'r') return '\r';
+        if (c == 'b') return '\b';
+        return c;
+    }
+
+    STRING_T Unescape(std::string_view text) {
+        STRING_T res;
+        res.reserve(text.size());
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '\\') res += EscapedChar(text[++i]);
+            else res += text[i];
+        }
+        return res;
+    }
 
-                if (c == '\\') {
-                    pos = fd.tellg();
-                    c = fd.get();
-                    if (fd.fail() || c == EOF) {
-                        Highlight(token.begin_in_text, pos);
+    // scans the token at p, which is not a space, and returns where the token ends
+    static const char *Scan(const char *begin, const char *p, const char *end, Token &token) {
+        int pos = p - begin;
+        switch (Class(*p)) {
+            case OPEN_CHAR: {
+                token = MakeToken(OPEN_BRACKET, pos, pos);
+                return p + 1;
+            }
+            case CLOSE_CHAR: {
+                token = MakeToken(CLOSED_BRACKED, pos, pos);
+                return p + 1;
+            }
+            case STRING_QUOTE: {
+                const char *q = p + 1;
+                while (q < end && *q != '"') {
+                    if (*q == '\\' && ++q == end) {
+                        Highlight(pos, q - begin - 1);
                         TokenizationError("Expected a character");
                     }
-                    if (c == 'n') token.char_literal = '\n';
-                    else if (c == 't') token.char_literal = '\t';
-                    else if (c == 'r') token.char_literal = '\r';
-                    else if (c == 'b') token.char_literal = '\b';
-                    else token.char_literal = c;
+                    q++;
                 }
-                else {
-                    token.char_literal = c;
+                if (q == end) {
+                    Highlight(pos, q - begin - 1);
+                    TokenizationError("Expected a double quote");
                 }
 
-                pos = fd.tellg();
-                c = fd.get();
-                if (fd.fail() || c != '\'') {
-                    Highlight(token.begin_in_text, pos);
+                token = MakeToken(STRING_LITERAL, pos, q - begin);
+                token.text = std::string_view(p + 1, q - p - 1);
+                return q + 1;
+            }
+            case CHAR_QUOTE: {
+                token = MakeToken(CHAR_LITERAL, pos, pos);
+                const char *q = p + 1;
+                if (q < end && *q == '\\') q++;
+                if (q >= end) {
+                    Highlight(pos, end - begin - 1);
+                    TokenizationError("Expected a character");
+                }
+                token.char_literal = q == p + 1 ? *q : EscapedChar(*q);
+                q++;
+                if (q == end || *q != '\'') {
+                    Highlight(pos, q - begin);
                     TokenizationError("Expected a single quote");
                 }
-                res.push_back(token);
-                continue;
+                token.end_in_text = q - begin;
+                return q + 1;
             }
-            
-            std::string kw;
-            if (c == '(') {
-                if (!stack.empty())
-                    res.push_back(Token{NAME, 0, 0, 0, 0, "",
-                                Names::GetName(stack), 
-                                pos - (int)stack.size(), 
-                                pos - 1});
-                stack = "";
-
-                res.push_back(Token{OPEN_BRACKET, 0, 0, 0, 0, "", 
-                                    {}, pos, pos});
-                continue;
+            default: {
+                const char *q = p + 1;
+                while (q < end && Class(*q) == WORD_CHAR) q++;
+                token = WordToken(std::string_view(p, q - p), pos);
+                return q;
             }
-            if (c == ')') {
-                if (!stack.empty()) 
-                    for (auto kw: keywords) {
-                        if (stack != kw) continue;    
-                        res.push_back(Token{(TokenId)KeywordId(kw), 0, 0, 0, 0, "", 
-                                            {}, pos - (int)kw.size() + 1, pos});
-                        stack = "";
-                        break;
-                    }
-                if (!stack.empty())
-                    res.push_back(Token{NAME, 0, 0, 0, 0, "",
-                                Names::GetName(stack), 
-                                pos - (int)stack.size(), 
-                                pos - 1});
-                stack = "";
-
-                res.push_back(Token{CLOSED_BRACKED, 0, 0, 0, 0, "", 
-                                    {}, pos, pos});
-                continue;
-            }
-            stack += c;
-        }
-        if (!stack.empty()) {
-            res.push_back(Token{NAME, 0, 0, 0, 0, "", Names::GetName(stack), 
-                                pos - (int)stack.size() + 1, pos});
         }
+    }
 
-        // stage2
+    static const char *SkipSpaces(const char *p, const char *end) {
+        while (p < end && Class(*p) == SPACE_CHAR) p++;
+        return p;
+    }
+
+    std::vector<Token> Do(const Source &source) {
+        return Do(source, 0, source.size);
+    }
+    std::vector<Token> Do(const Source &source, size_t from, size_t to) {
+        std::vector<Token> res;
+        const char *begin = source.data, *end = source.data + to;
+        Token token;
+        for (const char *p = SkipSpaces(begin + from, end); p < end; p = SkipSpaces(p, end)) {
+            p = Scan(begin, p, end, token);
+            res.push_back(token);
+        }
+        return res;
+    }
 
-        for (auto &token: res) {
-            if (token.id != NAME) continue;
+    std::vector<size_t> Split(const Source &source, size_t parts) {
+        std::vector<size_t> res = {0};
+        const char *text = source.data;
+        size_t size = source.size, step = size / parts, next = step;
 
-            BOOL_T bool_res;
-            if (IsBool(*token.name.str, bool_res)) {
-                token.id = BOOL_LITERAL;
-                token.bool_literal = bool_res;
-                continue;
-            }
-            INT_T int_res;
-            if (IsInt(*token.name.str, int_res)) {
-                token.id = INT_LITERAL;
-                token.int_literal = int_res;
-                continue;
-            }
-            REAL_T real_res;
-            if (IsReal(*token.name.str, real_res)) {
-                token.id = REAL_LITERAL;
-                token.real_literal = real_res;
-                continue;
-            }
-            if (IsNULL(*token.name.str)) {
-                token.id = NULL_LITERAL;
-                continue;
-            }
-            if (IsDict(*token.name.str)) {
-                token.id = DICT_LITERAL;
-                continue;
+        // only brackets and quotes matter here, a literal is skipped the way Scan reads it
+        int depth = 0;
+        for (size_t i = 0; i < size; i++) {
+            CharClass type = Class(text[i]);
+            if (type == WORD_CHAR || type == SPACE_CHAR) continue;
+            switch (text[i]) {
+                case '(': {
+                    depth++;
+                    break;
+                }
+                case ')': {
+                    if (depth > 0) depth--;
+                    if (depth == 0 && i + 1 >= next && res.size() < parts) {
+                        res.push_back(i + 1);
+                        next = i + 1 + step;
+                    }
+                    break;
+                }
+                case '"': {
+                    for (i++; i < size && text[i] != '"'; i++) {
+                        if (text[i] == '\\') i++;
+                    }
+                    break;
+                }
+                case '\'': {
+                    if (i + 1 < size && text[i + 1] == '\\') i++;
+                    i += 2;
+                    break;
+                }
             }
         }
+        if (res.back() < size) res.push_back(size);
         return res;
     }
-}
\ No newline at end of file
+
+    // pages of a mapped source are given back to the system once a stream is this far past them
+    static const size_t release_step = 1 << 24;
+
+    bool NextForm(Stream &stream, std::vector<Token> &tokens) {
+        tokens.clear();
+        const char *begin = stream.source->data, *end = stream.source->data + stream.source->size;
+        const char *p = SkipSpaces(begin + stream.pos, end);
+        size_t form_begin = p - begin;
+
+        // a form ends where its brackets are closed, a name or a literal is a form by itself
+        int depth = 0;
+        Token token;
+        while (p < end) {
+            p = Scan(begin, p, end, token);
+            tokens.push_back(token);
+            if (token.id == OPEN_BRACKET) depth++;
+            else if (token.id == CLOSED_BRACKED) depth--;
+            if (depth <= 0) break;
+            p = SkipSpaces(p, end);
+        }
+        stream.pos = p - begin;
+
+        if (stream.source->mapped && form_begin - stream.released >= release_step) {
+            size_t page = sysconf(_SC_PAGESIZE), until = form_begin / page * page;
+            madvise((void*)(begin + stream.released), until - stream.released, MADV_DONTNEED);
+            stream.released = until;
+        }
+        return !tokens.empty();
+    }
+}
@@ -4,27 +4,59 @@
 #include "names.hpp"
 
 #include <vector>
-#include <fstream>
+#include <string_view>
 
 namespace Tokenizer {
     enum TokenId {
-        SET, WHILE, FOR, REPEAT, IF, CONTINUE, BREAK, RETURN, FUNC, ARG, CALL,
+        SET, WHILE, FOR, REPEAT, EACH, IF, CONTINUE, BREAK, RETURN, FUNC, ARG, CALL,
         BOOL, CHAR, INT, REAL, STRING, DEREF, REF, INV, NOT, NEG, MULT, DIV, REM,
         ADD, SUB, SHL, SHR, LT, GT, LE, GE, EQ, NEQ, AND, XOR, OR, CONJ, DISJ,
         DACCESS, DSIZE, DPRESENT, DINSERT, DREMOVE, DKEYS, DVALUES, DCLEAR,
-        SACCESS, SSIZE, SADDSUF, SADDPREF, SREMOVESUF, SREMOVEPREF, OPEN_BRACKET, 
-        CLOSED_BRACKED, BOOL_LITERAL, CHAR_LITERAL, INT_LITERAL, REAL_LITERAL, 
-        STRING_LITERAL, NULL_LITERAL, DICT_LITERAL, NAME, 
+        SACCESS, SSIZE, SADDSUF, SADDPREF, SREMOVESUF, SREMOVEPREF, OPEN_BRACKET,
+        CLOSED_BRACKED, BOOL_LITERAL, CHAR_LITERAL, INT_LITERAL, REAL_LITERAL,
+        STRING_LITERAL, NULL_LITERAL, DICT_LITERAL, NAME,
     };
     struct Token {
         TokenId id;
-        BOOL_T bool_literal;
-        CHAR_T char_literal;
-        INT_T int_literal;
-        REAL_T real_literal;
-        STRING_T string_literal;
-        Names::Name name;
         int begin_in_text, end_in_text;
+        union {
+            BOOL_T bool_literal;
+            CHAR_T char_literal;
+            INT_T int_literal = 0;
+            REAL_T real_literal;
+            Names::Name name;
+            std::string_view text; // contents of a string literal, see Unescape
+        };
+        Token() {}
     };
-    std::vector<Token> Do(std::fstream &fd);
-}
\ No newline at end of file
+
+    // the text of a source file, mapped into memory when possible
+    struct Source {
+        const char *data;
+        size_t size;
+        bool mapped;
+    };
+    bool Load(const char *file, Source &source);
+    void Unload(Source &source);
+
+    std::vector<Token> Do(const Source &source);
+    std::vector<Token> Do(const Source &source, size_t from, size_t to); // positions stay those in the whole source
+    // cuts the source between top-level forms into at most parts pieces of about the same size,
+    // returns where they begin, followed by the size of the source
+    std::vector<size_t> Split(const Source &source, size_t parts);
+
+    // a source read one top-level form at a time
+    struct Stream {
+        const Source *source;
+        size_t pos, released;
+    };
+    // false when there are no forms left
+    bool NextForm(Stream &stream, std::vector<Token> &tokens);
+    STRING_T Unescape(std::string_view text);
+
+    /*
+
+    tokens of string literals point into the source, so it must outlive them
+
+    */
+}
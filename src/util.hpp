@@ -4,9 +4,11 @@
 #include <cstdint>
 
 struct DICT_T;
+struct ARRAY_T;
 struct FUNC_T;
 struct Object;
 struct Node;
+struct Chunk;
 using BOOL_T = bool;
 using CHAR_T = int8_t;
 using INT_T = int64_t;
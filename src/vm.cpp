@@ -0,0 +1,468 @@
+#include "vm.hpp"
+
+#include <vector>
+
+#include "compiler.hpp"
+#include "parser.hpp"
+#include "namespaces.hpp"
+#include "objects.hpp"
+#include "errors.hpp"
+#include "gc.hpp"
+#include "names.hpp"
+
+namespace VM {
+    static bool enabled = false;
+    static std::vector<Object*> stack;
+
+    void Enable() {
+        enabled = true;
+    }
+    bool Enabled() {
+        return enabled;
+    }
+
+    static inline Object *Pop() {
+        Object *res = stack.back();
+        stack.pop_back();
+        return res;
+    }
+    static inline void Push(Object *obj) {
+        stack.push_back(obj);
+    }
+    // Parser::Execute highlights every node it enters, so an operation that fails points at the last node
+    // evaluated before it. here only the instructions of nodes without kids do that, and checks highlight
+    // their node when they fail
+    static inline void Highlight(const Compiler::Instruction &ins) {
+        Errors::Highlight(ins.begin_in_text, ins.end_in_text);
+    }
+    static inline Object *Track(Object *obj) {
+        Namespaces::Track(Namespaces::Current(), obj);
+        return obj;
+    }
+
+    static Object *Run(Chunk *chunk) {
+        using namespace Compiler;
+
+        int base = stack.size();
+        Instruction *code = chunk->code.data();
+        int pc = 0;
+
+        while (true) {
+            Instruction &ins = code[pc++];
+
+            switch (ins.op) {
+                case PUSH_NULL: {
+                    Push(NULL);
+                    break;
+                }
+                case PUSH_CONST: {
+                    Highlight(ins);
+                    Push(ins.constant);
+                    break;
+                }
+                case PUSH_BOOL: {
+                    Highlight(ins);
+                    Object *res = Objects::Create(Objects::BOOL);
+                    *Objects::GetBool(res) = ins.bool_literal;
+                    Push(Track(res));
+                    break;
+                }
+                case PUSH_CHAR: {
+                    Highlight(ins);
+                    Object *res = Objects::Create(Objects::CHAR);
+                    *Objects::GetChar(res) = ins.char_literal;
+                    Push(Track(res));
+                    break;
+                }
+                case PUSH_INT: {
+                    Highlight(ins);
+                    Object *res = Objects::Create(Objects::INT);
+                    *Objects::GetInt(res) = ins.int_literal;
+                    Push(Track(res));
+                    break;
+                }
+                case PUSH_REAL: {
+                    Highlight(ins);
+                    Object *res = Objects::Create(Objects::REAL);
+                    *Objects::GetReal(res) = ins.real_literal;
+                    Push(Track(res));
+                    break;
+                }
+                case PUSH_STRING: {
+                    Highlight(ins);
+                    Object *res = Objects::Copy(ins.constant, false);
+                    Push(Track(res));
+                    break;
+                }
+                case PUSH_POINTER: {
+                    Highlight(ins);
+                    Object *res = Objects::Create(Objects::POINTER);
+                    *Objects::GetPtr(res) = NULL;
+                    Push(Track(res));
+                    break;
+                }
+                case PUSH_DICT: {
+                    Highlight(ins);
+                    Push(Track(Objects::Create(Objects::DICT)));
+                    break;
+                }
+                case LOAD_NAME: {
+                    Highlight(ins);
+                    Object *res = Namespaces::Find(Namespaces::Current(), *ins.addresses);
+                    if (res == NULL) RuntimeError("Couldn't find object by name " + std::string(Names::GetString(ins.arg)));
+                    Push(res);
+                    break;
+                }
+                case STORE_NAME:
+                case BIND_NAME: { // BIND_NAME is used for objects that are never temporaries
+                    Object *second = Pop();
+                    Object *first = Namespaces::Find(Namespaces::Current(), *ins.addresses);
+                    if (first != NULL) {
+                        Objects::ReplaceWithCopy(first, second, true);
+                    }
+                    else {
+                        Object *second_copy = Objects::Copy(second, true);
+                        Namespaces::Track(Namespaces::Current(), second_copy);
+                        Namespaces::Add(Namespaces::Current(), (*ins.addresses)[0].slot, second_copy);
+                    }
+                    if (ins.op == STORE_NAME) Parser::TryDestroying(second);
+                    break;
+                }
+                case STORE: {
+                    Object *second = Pop();
+                    Object *first = Pop();
+                    Objects::ReplaceWithCopy(first, second, true);
+                    Parser::TryDestroying(second);
+                    break;
+                }
+                case CHECK_VALUE: {
+                    if (stack.back() == NULL) {
+                        Highlight(ins);
+                        RuntimeError("Expected a value");
+                    }
+                    break;
+                }
+                case CHECK_REFERENCEABLE: {
+                    if (!Objects::IsReferenceable(stack.back())) {
+                        Highlight(ins);
+                        RuntimeError("Not referenceable");
+                    }
+                    break;
+                }
+                case CHECK_TYPE: {
+                    Object *obj = stack.back();
+                    if (obj == NULL || (Objects::GetType(obj) & ins.arg) == 0) {
+                        Highlight(ins);
+                        RuntimeError(ins.message);
+                    }
+                    break;
+                }
+                case POP: {
+                    Parser::TryDestroying(Pop());
+                    break;
+                }
+                case JUMP: {
+                    if (ins.arg < pc) GC::Poll(); // loops jump backwards
+                    pc = ins.arg;
+                    break;
+                }
+                case JUMP_IF_FALSE:
+                case JUMP_IF_TRUE: {
+                    Object *cond = Pop();
+                    if (cond == NULL || Objects::GetType(cond) != Objects::BOOL) {
+                        Highlight(ins);
+                        RuntimeError(ins.message);
+                    }
+                    bool value = *Objects::GetBool(cond);
+                    Parser::TryDestroying(cond);
+                    if (value == (ins.op == JUMP_IF_TRUE)) pc = ins.arg;
+                    break;
+                }
+                case ENTER_SCOPE: {
+                    Namespaces::Create(true, ins.arg, ins.bool_literal);
+                    break;
+                }
+                case LEAVE_SCOPE: {
+                    Namespaces::Destroy();
+                    break;
+                }
+                case UNWIND: {
+                    for (int i = 0; i < ins.arg; i++) Namespaces::Destroy();
+                    break;
+                }
+                case RETURN_OUT: {
+                    Object *res = Pop();
+                    Object *ret = Namespaces::Promote(Namespaces::Current() - ins.arg, res);
+                    if (ret != res) Parser::TryDestroying(res);
+                    for (int i = 0; i < ins.arg; i++) Namespaces::Destroy();
+                    Push(ret);
+                    break;
+                }
+                case DROP: {
+                    stack.resize(stack.size() - ins.arg);
+                    break;
+                }
+                case EACH_START: {
+                    Object *dict = Pop();
+                    Object *snapshot = Objects::DictSnapshot(dict);
+                    Object *pos = Objects::Create(Objects::INT);
+                    GC::Register(snapshot);
+                    GC::Register(pos);
+                    Parser::TryDestroying(dict);
+                    Push(snapshot);
+                    Push(pos);
+                    break;
+                }
+                case EACH_NEXT: {
+                    INT_T &pos = *Objects::GetInt(stack.back());
+                    Object *key, *val;
+                    if (!Objects::DictEntryAt(stack[stack.size() - 2], pos, key, val)) {
+                        pc = ins.arg;
+                        break;
+                    }
+                    pos++;
+                    Push(key);
+                    Push(val);
+                    break;
+                }
+                case EACH_END: {
+                    GC::Free(Pop());
+                    GC::Free(Pop());
+                    break;
+                }
+                case MAKE_FUNC: {
+                    Highlight(ins);
+                    Object *func = Track(Objects::Create(Objects::FUNCTION));
+                    CustomTypes::FuncFromNode(Objects::GetFunc(func), ins.node);
+                    Push(func);
+                    break;
+                }
+                case ARG: {
+                    Object *index = Pop();
+                    Object *arg = Namespaces::AccessStack(Namespaces::Current(), *Objects::GetInt(index));
+                    Parser::TryDestroying(index);
+                    Push(arg);
+                    break;
+                }
+                case CALL: {
+                    int first = stack.size() - ins.arg;
+                    Object *func = stack[first - 1];
+
+                    GC::Poll();
+                    Namespaces::Create(false, 0);
+                    for (int i = stack.size() - 1; i >= first; i--) {
+                        if (!Namespaces::PushArg(stack[i])) stack[i] = NULL;
+                    }
+                    Object *ret = CustomTypes::FuncCall(Objects::GetFunc(func));
+                    Object *res = Namespaces::Promote(Namespaces::Parent(), ret);
+                    Namespaces::Destroy();
+
+                    for (int i = stack.size() - 1; i >= first; i--) Parser::TryDestroying(stack[i]);
+                    Parser::TryDestroying(func);
+                    stack.resize(first - 1);
+                    Push(res);
+                    break;
+                }
+                case CAST_BOOL:
+                case CAST_CHAR:
+                case CAST_INT:
+                case CAST_REAL:
+                case CAST_STRING: {
+                    Object *arg = Pop();
+                    Object *res;
+                    switch (ins.op) {
+                        case CAST_BOOL: res = Objects::CastToBool(arg); break;
+                        case CAST_CHAR: res = Objects::CastToChar(arg); break;
+                        case CAST_INT: res = Objects::CastToInt(arg); break;
+                        case CAST_REAL: res = Objects::CastToReal(arg); break;
+                        default: res = Objects::CastToString(arg); break;
+                    }
+                    Track(res);
+                    Parser::TryDestroying(arg);
+                    Push(res);
+                    break;
+                }
+                case DEREF: {
+                    Object *arg = Pop();
+                    Object *res = Objects::Deref(arg);
+                    Parser::TryDestroying(arg);
+                    Push(res);
+                    break;
+                }
+                case REF: {
+                    Push(Track(Objects::Ref(Pop())));
+                    break;
+                }
+                case INV:
+                case NOT:
+                case NEG: {
+                    Object *arg = Pop();
+                    Object *res;
+                    switch (ins.op) {
+                        case INV: res = Objects::CalcInv(arg); break;
+                        case NOT: res = Objects::CalcNot(arg); break;
+                        default: res = Objects::CalcNeg(arg); break;
+                    }
+                    Track(res);
+                    Parser::TryDestroying(arg);
+                    Push(res);
+                    break;
+                }
+                case MULT:
+                case DIV:
+                case REM:
+                case ADD:
+                case SUB:
+                case SHL:
+                case SHR:
+                case LT:
+                case GT:
+                case LE:
+                case GE:
+                case EQ:
+                case NEQ:
+                case AND:
+                case XOR:
+                case OR:
+                case CONJ:
+                case DISJ: {
+                    Object *arg2 = Pop();
+                    Object *arg1 = Pop();
+                    Object *res;
+                    switch (ins.op) {
+                        case MULT: res = Objects::CalcMult(arg1, arg2); break;
+                        case DIV: res = Objects::CalcDiv(arg1, arg2); break;
+                        case REM: res = Objects::CalcRem(arg1, arg2); break;
+                        case ADD: res = Objects::CalcAdd(arg1, arg2); break;
+                        case SUB: res = Objects::CalcSub(arg1, arg2); break;
+                        case SHL: res = Objects::CalcShl(arg1, arg2); break;
+                        case SHR: res = Objects::CalcShr(arg1, arg2); break;
+                        case LT: res = Objects::CalcLt(arg1, arg2); break;
+                        case GT: res = Objects::CalcGt(arg1, arg2); break;
+                        case LE: res = Objects::CalcLe(arg1, arg2); break;
+                        case GE: res = Objects::CalcGe(arg1, arg2); break;
+                        case EQ: res = Objects::CalcEq(arg1, arg2); break;
+                        case NEQ: res = Objects::CalcNeq(arg1, arg2); break;
+                        case AND: res = Objects::CalcAnd(arg1, arg2); break;
+                        case XOR: res = Objects::CalcXor(arg1, arg2); break;
+                        case OR: res = Objects::CalcOr(arg1, arg2); break;
+                        case CONJ: res = Objects::CalcConj(arg1, arg2); break;
+                        default: res = Objects::CalcDisj(arg1, arg2); break;
+                    }
+                    Track(res);
+                    Parser::TryDestroying(arg1);
+                    Parser::TryDestroying(arg2);
+                    Push(res);
+                    break;
+                }
+                case DACCESS: {
+                    Object *arg = Pop();
+                    Object *dict = Pop();
+                    Object *res = Objects::DictAccess(dict, arg);
+                    Parser::TryDestroying(dict);
+                    Parser::TryDestroying(arg);
+                    Push(res);
+                    break;
+                }
+                case DSIZE: {
+                    Object *dict = Pop();
+                    Object *res = Track(Objects::DictSize(dict));
+                    Parser::TryDestroying(dict);
+                    Push(res);
+                    break;
+                }
+                case DPRESENT: {
+                    Object *arg = Pop();
+                    Object *dict = Pop();
+                    Object *res = Track(Objects::DictPresent(dict, arg));
+                    Parser::TryDestroying(dict);
+                    Parser::TryDestroying(arg);
+                    Push(res);
+                    break;
+                }
+                case DINSERT: {
+                    Object *arg2 = Pop();
+                    Object *arg1 = Pop();
+                    Object *dict = Pop();
+                    Objects::DictInsert(dict, arg1, arg2);
+                    Parser::TryDestroying(dict);
+                    Parser::TryDestroying(arg1);
+                    Parser::TryDestroying(arg2);
+                    break;
+                }
+                case DREMOVE: {
+                    Object *arg = Pop();
+                    Object *dict = Pop();
+                    Objects::DictRemove(dict, arg);
+                    Parser::TryDestroying(dict);
+                    Parser::TryDestroying(arg);
+                    break;
+                }
+                case DKEYS:
+                case DVALUES: {
+                    Object *dict = Pop();
+                    Object *res = ins.op == DKEYS ? Objects::DictKeys(dict) : Objects::DictValues(dict);
+                    Track(res);
+                    Parser::TryDestroying(dict);
+                    Push(res);
+                    break;
+                }
+                case DCLEAR: {
+                    Objects::DictClear(Pop());
+                    break;
+                }
+                case SACCESS: {
+                    Object *arg = Pop();
+                    Object *str = Pop();
+                    Object *res = Track(Objects::StringAccess(str, arg));
+                    Parser::TryDestroying(str);
+                    Parser::TryDestroying(arg);
+                    Push(res);
+                    break;
+                }
+                case SSIZE: {
+                    Object *str = Pop();
+                    Object *res = Track(Objects::StringSize(str));
+                    Parser::TryDestroying(str);
+                    Push(res);
+                    break;
+                }
+                case SADDSUF:
+                case SADDPREF:
+                case SREMOVESUF:
+                case SREMOVEPREF: {
+                    Object *arg = Pop();
+                    Object *str = Pop();
+                    switch (ins.op) {
+                        case SADDSUF: Objects::StringAddSuf(str, arg); break;
+                        case SADDPREF: Objects::StringAddPref(str, arg); break;
+                        case SREMOVESUF: Objects::StringRemoveSuf(str, arg); break;
+                        default: Objects::StringRemovePref(str, arg); break;
+                    }
+                    Parser::TryDestroying(arg);
+                    break;
+                }
+                case ERROR: {
+                    Highlight(ins);
+                    RuntimeError(ins.message);
+                    break;
+                }
+                case RET: {
+                    Object *res = Pop();
+                    stack.resize(base);
+                    return res;
+                }
+            }
+        }
+    }
+
+    void MarkRoots() {
+        for (auto obj: stack) GC::Mark(obj);
+    }
+
+    Object *Execute(Node *node) {
+        Chunk *&chunk = Parser::GetChunk(node);
+        if (chunk == NULL) chunk = Compiler::Compile(node);
+        return Run(chunk);
+    }
+}
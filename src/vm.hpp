@@ -0,0 +1,20 @@
+#pragma once
+
+#include "util.hpp"
+
+namespace VM {
+    /*
+
+    an alternative engine to Parser::Execute.
+    nodes are compiled into bytecode once, and then executed by a loop over instructions.
+
+    */
+    void Enable();
+    bool Enabled();
+
+    // same as Parser::Execute called on a function body or a top-level form
+    Object *Execute(Node *node);
+
+    // marks the objects on the stack for the garbage collector
+    void MarkRoots();
+}